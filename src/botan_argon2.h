@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_ARGON2_H
+#define BOTAN_ARGON2_H
+
+static Janet argon2(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 7);
+    size_t out_len = janet_getsize(argv, 0);
+    JanetByteView pass = janet_getbytes(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+
+    size_t M = janet_optsize(argv, argc, 3, 19456);
+    size_t t = janet_optsize(argv, argc, 4, 2);
+    size_t p = janet_optsize(argv, argc, 5, 1);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 6);
+    int ret;
+
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        ret = botan_pwdhash("Argon2id", M, t, p,
+                            out, out_len,
+                            (const char *)pass.bytes, pass.len,
+                            salt.bytes, salt.len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
+    JanetBuffer *out = janet_buffer(out_len);
+    ret = botan_pwdhash("Argon2id", M, t, p,
+                        out->data, out_len,
+                        (const char *)pass.bytes, pass.len,
+                        salt.bytes, salt.len);
+    JANET_BOTAN_ASSERT(ret);
+
+    out->count = out_len;
+    return janet_wrap_string(janet_string(out->data, out->count));
+}
+
+static Janet argon2_async(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 7);
+    size_t out_len = janet_getsize(argv, 0);
+    JanetByteView pass = janet_getbytes(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+    size_t M = janet_optsize(argv, argc, 3, 19456);
+    size_t t = janet_optsize(argv, argc, 4, 2);
+    size_t p = janet_optsize(argv, argc, 5, 1);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 6);
+
+    pwdhash_job_t *j = pwdhash_job_new("Argon2id", pass, salt, out_len, secure_out);
+    j->param1 = M;
+    j->param2 = t;
+    j->param3 = p;
+
+    worker_pool_await(&j->job);
+}
+
+static JanetReg argon2_cfuns[] = {
+    {"argon2", argon2,
+     "(argon2 out-len password salt &opt M t p out)\n\n"
+     "Runs the Argon2id key derivation function over the specified "
+     "password and salt, using `M` KiB of memory, `t` passes and `p` "
+     "lanes. If omitted, the default values of M=19456, t=2, p=1 are "
+     "used. If the secure buffer `out` is given, the output is written "
+     "into it and `out` is returned instead."
+    },
+    {"argon2-async", argon2_async,
+     "(argon2-async out-len password salt &opt M t p out)\n\n"
+     "Like `argon2`, but the key is derived on the native worker pool "
+     "while the calling fiber yields to the event loop. Raises an error "
+     "right away if the worker pool queue is full."
+    },
+    {NULL, NULL, NULL}
+};
+
+static void submod_argon2(JanetTable *env) {
+    janet_cfuns(env, "botan", argon2_cfuns);
+}
+
+#endif /* BOTAN_ARGON2_H */
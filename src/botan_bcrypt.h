@@ -31,10 +31,136 @@ static Janet bcrypt_is_valid(int32_t argc, Janet *argv) {
     JanetByteView hashed = janet_getbytes(argv, 1);
     int ret;
 
+    uint8_t digest[DERIVE_CACHE_DIGEST_LEN];
+    uint8_t valid;
+    bool cached = derive_cache_digest(digest, "bcrypt", "", 0, 0, 0, 1, pass, hashed);
+
+    if (cached && derive_cache_get(digest, &valid, 1)) {
+        return janet_wrap_boolean(valid);
+    }
+
     ret = botan_bcrypt_is_valid((const char *)pass.bytes, (const char *)hashed.bytes);
     JANET_BOTAN_ASSERT(ret);
 
-    return janet_wrap_boolean(ret == 0);
+    valid = ret == 0;
+    if (cached) {
+        derive_cache_put(digest, &valid, 1);
+    }
+    return janet_wrap_boolean(valid);
+}
+
+/* Async variants */
+typedef struct bcrypt_job {
+    jbotan_job_t job;
+    uint8_t *password;
+    size_t password_capacity;
+    char *hashed;
+    size_t work_factor;
+    char out[64];
+    size_t out_len;
+} bcrypt_job_t;
+
+static int bcrypt_job_run(jbotan_job_t *job) {
+    bcrypt_job_t *j = (bcrypt_job_t *)job;
+
+    if (j->hashed) {
+        JanetByteView pass = {j->password, (int32_t)strlen((const char *)j->password)};
+        JanetByteView hashed = {(const uint8_t *)j->hashed, (int32_t)strlen(j->hashed)};
+        uint8_t digest[DERIVE_CACHE_DIGEST_LEN];
+        uint8_t valid;
+        bool cached = derive_cache_digest(digest, "bcrypt", "", 0, 0, 0, 1, pass, hashed);
+
+        if (cached && derive_cache_get(digest, &valid, 1)) {
+            return valid ? 0 : BOTAN_FFI_INVALID_VERIFIER;
+        }
+
+        /* A malformed hash never matches; report it as a mismatch rather
+         * than an error. */
+        int ret = botan_bcrypt_is_valid((const char *)j->password, j->hashed);
+        if (ret < 0) {
+            return BOTAN_FFI_INVALID_VERIFIER;
+        }
+        valid = ret == 0;
+        if (cached) {
+            derive_cache_put(digest, &valid, 1);
+        }
+        return ret;
+    }
+
+    botan_rng_t rng;
+    int ret = botan_rng_init(&rng, "system");
+    if (ret) {
+        return ret;
+    }
+
+    j->out_len = sizeof(j->out);
+    ret = botan_bcrypt_generate((uint8_t *)j->out, &j->out_len,
+                                (const char *)j->password,
+                                rng, j->work_factor, 0);
+    botan_rng_destroy(rng);
+    return ret;
+}
+
+static Janet bcrypt_job_finish(jbotan_job_t *job) {
+    bcrypt_job_t *j = (bcrypt_job_t *)job;
+
+    if (j->hashed) {
+        return janet_wrap_boolean(job->status == 0);
+    }
+    return janet_wrap_string(janet_string((const uint8_t *)j->out, j->out_len));
+}
+
+static void bcrypt_job_release(jbotan_job_t *job) {
+    bcrypt_job_t *j = (bcrypt_job_t *)job;
+
+    secure_arena_free(j->password, j->password_capacity);
+    janet_free(j->hashed);
+    janet_free(j);
+}
+
+static bcrypt_job_t *bcrypt_job_new(JanetByteView pass) {
+    bcrypt_job_t *j = janet_malloc(sizeof(bcrypt_job_t));
+    if (j == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(j, 0, sizeof(bcrypt_job_t));
+    j->job.run = bcrypt_job_run;
+    j->job.finish = bcrypt_job_finish;
+    j->job.release = bcrypt_job_release;
+    j->password = secure_arena_try_dup(pass, &j->password_capacity);
+    if (j->password == NULL) {
+        bcrypt_job_release(&j->job);
+        janet_panic("Failed to allocate secure memory");
+    }
+    return j;
+}
+
+static Janet bcrypt_async(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 2);
+    JanetByteView pass = janet_getbytes(argv, 0);
+    size_t work_factor = janet_optsize(argv, argc, 1, 10);
+
+    bcrypt_job_t *j = bcrypt_job_new(pass);
+    j->work_factor = work_factor;
+
+    worker_pool_await(&j->job);
+}
+
+static Janet bcrypt_is_valid_async(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+    JanetByteView pass = janet_getbytes(argv, 0);
+    JanetByteView hashed = janet_getbytes(argv, 1);
+
+    bcrypt_job_t *j = bcrypt_job_new(pass);
+    j->hashed = janet_malloc((size_t)hashed.len + 1);
+    if (j->hashed == NULL) {
+        bcrypt_job_release(&j->job);
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(j->hashed, hashed.bytes, hashed.len);
+    j->hashed[hashed.len] = 0;
+
+    worker_pool_await(&j->job);
 }
 
 static JanetReg bcrypt_cfuns[] = {
@@ -47,6 +173,20 @@ static JanetReg bcrypt_cfuns[] = {
      "Check a bcrypt hash against the provided password, returning true if "
      "the password matches."
     },
+    {"bcrypt-async", bcrypt_async,
+     "(bcrypt-async password &opt work-factor)\n\n"
+     "Like `bcrypt`, but the hash is computed on the native worker pool "
+     "while the calling fiber yields to the event loop. A system RNG is "
+     "used for the salt. Raises an error right away if the worker pool "
+     "queue is full."
+    },
+    {"bcrypt-is-valid-async", bcrypt_is_valid_async,
+     "(bcrypt-is-valid-async password bcrypt)\n\n"
+     "Like `bcrypt-is-valid`, but the check runs on the native worker pool "
+     "while the calling fiber yields to the event loop. Returns false for "
+     "a malformed `bcrypt` string. Raises an error right away if the "
+     "worker pool queue is full."
+    },
     {NULL, NULL, NULL}
 };
 
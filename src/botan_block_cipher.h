@@ -9,6 +9,7 @@
 
 typedef struct botan_block_cipher_obj {
     botan_block_cipher_t block_cipher;
+    size_t block_size;
 } botan_block_cipher_obj_t;
 
 /* Abstract Object functions */
@@ -25,6 +26,10 @@ static Janet block_cipher_clear(int32_t argc, Janet *argv);
 static Janet block_cipher_set_key(int32_t argc, Janet *argv);
 static Janet block_cipher_encrypt_blocks(int32_t argc, Janet *argv);
 static Janet block_cipher_decrypt_blocks(int32_t argc, Janet *argv);
+static Janet block_cipher_encrypt_into(int32_t argc, Janet *argv);
+static Janet block_cipher_decrypt_into(int32_t argc, Janet *argv);
+static Janet block_cipher_encrypt_batch(int32_t argc, Janet *argv);
+static Janet block_cipher_decrypt_batch(int32_t argc, Janet *argv);
 
 static JanetAbstractType block_cipher_obj_type = {
     "botan/block-cipher",
@@ -46,6 +51,10 @@ static JanetMethod block_cipher_methods[] = {
     {"set-key", block_cipher_set_key},
     {"encrypt", block_cipher_encrypt_blocks},
     {"decrypt", block_cipher_decrypt_blocks},
+    {"encrypt-into", block_cipher_encrypt_into},
+    {"decrypt-into", block_cipher_decrypt_into},
+    {"encrypt-batch", block_cipher_encrypt_batch},
+    {"decrypt-batch", block_cipher_decrypt_batch},
     {NULL, NULL},
 };
 
@@ -93,18 +102,18 @@ static Janet block_cipher_new(int32_t argc, Janet *argv) {
     int ret = botan_block_cipher_init(&obj->block_cipher, name);
     JANET_BOTAN_ASSERT(ret);
 
+    int size = botan_block_cipher_block_size(obj->block_cipher);
+    JANET_BOTAN_ASSERT(size);
+    obj->block_size = (size_t)size;
+
     return janet_wrap_abstract(obj);
 }
 
 static Janet block_cipher_block_size(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 1);
     botan_block_cipher_obj_t *obj = janet_getabstract(argv, 0, get_block_cipher_obj_type());
-    botan_block_cipher_t bc = obj->block_cipher;
 
-    int size = botan_block_cipher_block_size(bc);
-    JANET_BOTAN_ASSERT(size);
-
-    return janet_wrap_number((double)size);
+    return janet_wrap_number((double)obj->block_size);
 }
 
 static Janet block_cipher_name(int32_t argc, Janet *argv) {
@@ -166,10 +175,7 @@ static Janet block_cipher_encrypt_blocks(int32_t argc, Janet *argv) {
     JanetByteView input = janet_getbytes(argv, 1);
     JanetBuffer *output = janet_buffer(input.len);
 
-    int size = botan_block_cipher_block_size(bc);
-    JANET_BOTAN_ASSERT(size);
-
-    int blocks = input.len / size;
+    size_t blocks = input.len / obj->block_size;
     int ret = botan_block_cipher_encrypt_blocks(bc, input.bytes, output->data, blocks);
     JANET_BOTAN_ASSERT(ret);
 
@@ -184,10 +190,7 @@ static Janet block_cipher_decrypt_blocks(int32_t argc, Janet *argv) {
     JanetByteView input = janet_getbytes(argv, 1);
     JanetBuffer *output = janet_buffer(input.len);
 
-    int size = botan_block_cipher_block_size(bc);
-    JANET_BOTAN_ASSERT(size);
-
-    int blocks = input.len / size;
+    size_t blocks = input.len / obj->block_size;
     int ret = botan_block_cipher_decrypt_blocks(bc, input.bytes, output->data, blocks);
     JANET_BOTAN_ASSERT(ret);
 
@@ -195,6 +198,84 @@ static Janet block_cipher_decrypt_blocks(int32_t argc, Janet *argv) {
     return janet_wrap_buffer(output);
 }
 
+typedef int (*block_cipher_fn)(botan_block_cipher_t bc, const uint8_t in[],
+                               uint8_t out[], size_t blocks);
+
+static size_t block_cipher_check_len(botan_block_cipher_obj_t *obj, int32_t len) {
+    if ((size_t)len % obj->block_size != 0) {
+        janet_panicf("Input length %d is not a multiple of the block size %d",
+                     len, (int32_t)obj->block_size);
+    }
+    return (size_t)len / obj->block_size;
+}
+
+static Janet block_cipher_process_into(int32_t argc, Janet *argv, block_cipher_fn fn) {
+    janet_arity(argc, 2, 3);
+    botan_block_cipher_obj_t *obj = janet_getabstract(argv, 0, get_block_cipher_obj_type());
+    JanetBuffer *buf = janet_getbuffer(argv, 1);
+    int ret;
+
+    if (argc == 2) {
+        size_t blocks = block_cipher_check_len(obj, buf->count);
+        ret = fn(obj->block_cipher, buf->data, buf->data, blocks);
+        JANET_BOTAN_ASSERT(ret);
+        return janet_wrap_buffer(buf);
+    }
+
+    JanetByteView input = janet_getbytes(argv, 2);
+    size_t blocks = block_cipher_check_len(obj, input.len);
+    uint8_t *out = buffer_reserve_out(buf, input.len, &input);
+
+    ret = fn(obj->block_cipher, input.bytes, out, blocks);
+    JANET_BOTAN_ASSERT(ret);
+
+    buf->count += input.len;
+    return janet_wrap_buffer(buf);
+}
+
+static Janet block_cipher_encrypt_into(int32_t argc, Janet *argv) {
+    return block_cipher_process_into(argc, argv, botan_block_cipher_encrypt_blocks);
+}
+
+static Janet block_cipher_decrypt_into(int32_t argc, Janet *argv) {
+    return block_cipher_process_into(argc, argv, botan_block_cipher_decrypt_blocks);
+}
+
+static Janet block_cipher_process_batch(int32_t argc, Janet *argv, block_cipher_fn fn) {
+    janet_fixarity(argc, 2);
+    botan_block_cipher_obj_t *obj = janet_getabstract(argv, 0, get_block_cipher_obj_type());
+    JanetView bufs = janet_getindexed(argv, 1);
+
+    /* Validate everything up front so a bad element leaves all buffers
+     * untouched. */
+    for (int32_t i = 0; i < bufs.len; i++) {
+        if (!janet_checktype(bufs.items[i], JANET_BUFFER)) {
+            janet_panicf("Expected buffer at index %d, got %v", i, bufs.items[i]);
+        }
+        block_cipher_check_len(obj, janet_unwrap_buffer(bufs.items[i])->count);
+    }
+
+    for (int32_t i = 0; i < bufs.len; i++) {
+        JanetBuffer *buf = janet_unwrap_buffer(bufs.items[i]);
+        size_t blocks = (size_t)buf->count / obj->block_size;
+        if (blocks == 0) {
+            continue;
+        }
+        int ret = fn(obj->block_cipher, buf->data, buf->data, blocks);
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return argv[1];
+}
+
+static Janet block_cipher_encrypt_batch(int32_t argc, Janet *argv) {
+    return block_cipher_process_batch(argc, argv, botan_block_cipher_encrypt_blocks);
+}
+
+static Janet block_cipher_decrypt_batch(int32_t argc, Janet *argv) {
+    return block_cipher_process_batch(argc, argv, botan_block_cipher_decrypt_blocks);
+}
+
 static JanetReg block_cipher_cfuns[] = {
     {"block-cipher/new", block_cipher_new,
      "(block-cipher/new name)\n\n"
@@ -235,6 +316,32 @@ static JanetReg block_cipher_cfuns[] = {
      "Decrypt `input` data. The key must have been set beforehand. "
      "Returns decrypted data in buffer format."
     },
+    {"block-cipher/encrypt-into", block_cipher_encrypt_into,
+     "(block-cipher/encrypt-into bc-obj buf &opt input)\n\n"
+     "Encrypt `input` and append the result to the buffer `buf`. If `input` "
+     "is omitted, the contents of `buf` are encrypted in place. The length "
+     "of the data must be a multiple of the block size. Returns `buf`."
+    },
+    {"block-cipher/decrypt-into", block_cipher_decrypt_into,
+     "(block-cipher/decrypt-into bc-obj buf &opt input)\n\n"
+     "Decrypt `input` and append the result to the buffer `buf`. If `input` "
+     "is omitted, the contents of `buf` are decrypted in place. The length "
+     "of the data must be a multiple of the block size. Returns `buf`."
+    },
+    {"block-cipher/encrypt-batch", block_cipher_encrypt_batch,
+     "(block-cipher/encrypt-batch bc-obj buffers)\n\n"
+     "Encrypt each buffer of the array or tuple `buffers` in place, all "
+     "under the current key. Every buffer length must be a multiple of the "
+     "block size, which is checked before any buffer is modified. Returns "
+     "`buffers`."
+    },
+    {"block-cipher/decrypt-batch", block_cipher_decrypt_batch,
+     "(block-cipher/decrypt-batch bc-obj buffers)\n\n"
+     "Decrypt each buffer of the array or tuple `buffers` in place, all "
+     "under the current key. Every buffer length must be a multiple of the "
+     "block size, which is checked before any buffer is modified. Returns "
+     "`buffers`."
+    },
     {NULL, NULL, NULL}
 };
 
@@ -0,0 +1,647 @@
+/*
+ * Copyright (c) 2026, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_CODEC_H
+#define BOTAN_CODEC_H
+
+/*
+ * Hex and base64 codecs producing the same output as botan_hex_encode and
+ * botan_base64_encode. Bulk input is converted with SSSE3/AVX2 (selected at
+ * runtime) or NEON, anything else goes through the scalar code. Decoders
+ * skip whitespace; input the vector loops cannot handle (whitespace,
+ * padding, invalid characters) is passed to the scalar code, which also
+ * reports errors.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JBOTAN_CODEC_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define JBOTAN_CODEC_NEON
+#include <arm_neon.h>
+#endif
+
+#define CODEC_SIMD_NONE  0
+#define CODEC_SIMD_SSSE3 1
+#define CODEC_SIMD_AVX2  2
+#define CODEC_SIMD_NEON  3
+
+static const char codec_hex_chars[16] = "0123456789ABCDEF";
+
+static const char codec_base64_chars[2][64] = {
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+};
+
+static int codec_simd_level(void) {
+    static int level = -1;
+    if (level >= 0) {
+        return level;
+    }
+
+#if defined(JBOTAN_CODEC_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        level = CODEC_SIMD_AVX2;
+    } else if (__builtin_cpu_supports("ssse3")) {
+        level = CODEC_SIMD_SSSE3;
+    } else {
+        level = CODEC_SIMD_NONE;
+    }
+#elif defined(JBOTAN_CODEC_NEON)
+    level = CODEC_SIMD_NEON;
+#else
+    level = CODEC_SIMD_NONE;
+#endif
+
+    return level;
+}
+
+static size_t codec_base64_encoded_len(size_t len, bool padding) {
+    if (padding) {
+        return ((len + 2) / 3) * 4;
+    }
+    return (len / 3) * 4 + ((len % 3) ? (len % 3) + 1 : 0);
+}
+
+static int codec_is_space(uint8_t c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int codec_hex_value(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static int codec_base64_value(uint8_t c, int url) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == (url ? '-' : '+')) return 62;
+    if (c == (url ? '_' : '/')) return 63;
+    return -1;
+}
+
+/* SIMD kernels. Each one converts as many whole blocks as it can and
+ * returns the number of input bytes consumed. */
+
+#if defined(JBOTAN_CODEC_X86)
+
+__attribute__((target("ssse3")))
+static size_t hex_encode_ssse3(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m128i lut = _mm_loadu_si128((const __m128i *)codec_hex_chars);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t hex_encode_avx2(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m256i lut = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)codec_hex_chars));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i *)(out + 2 * i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + 2 * i + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+
+    return i + hex_encode_ssse3(in + i, len - i, out + 2 * i);
+}
+
+/* Returns 16 nibble values for 16 hex characters, or sets `*bad` when one of
+ * them is not a hex digit. */
+__attribute__((target("ssse3")))
+static __m128i hex_decode_nibbles_ssse3(__m128i v, int *bad) {
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+    __m128i is_digit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+    __m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+    __m128i is_alpha = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+    if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_alpha)) != 0xffff) {
+        *bad = 1;
+    }
+    return _mm_or_si128(_mm_and_si128(is_digit, d),
+                        _mm_and_si128(is_alpha, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+__attribute__((target("ssse3")))
+static size_t hex_decode_ssse3(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m128i weights = _mm_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        int bad = 0;
+        __m128i a = hex_decode_nibbles_ssse3(_mm_loadu_si128((const __m128i *)(in + i)), &bad);
+        __m128i b = hex_decode_nibbles_ssse3(_mm_loadu_si128((const __m128i *)(in + i + 16)), &bad);
+        if (bad) {
+            break;
+        }
+        a = _mm_maddubs_epi16(a, weights);
+        b = _mm_maddubs_epi16(b, weights);
+        _mm_storeu_si128((__m128i *)(out + i / 2), _mm_packus_epi16(a, b));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static __m256i hex_decode_nibbles_avx2(__m256i v, int *bad) {
+    __m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+    __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+    __m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+    __m256i is_alpha = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+    if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_alpha)) != -1) {
+        *bad = 1;
+    }
+    return _mm256_or_si256(_mm256_and_si256(is_digit, d),
+                           _mm256_and_si256(is_alpha, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+}
+
+__attribute__((target("avx2")))
+static size_t hex_decode_avx2(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for (; i + 64 <= len; i += 64) {
+        int bad = 0;
+        __m256i a = hex_decode_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(in + i)), &bad);
+        __m256i b = hex_decode_nibbles_avx2(_mm256_loadu_si256((const __m256i *)(in + i + 32)), &bad);
+        if (bad) {
+            break;
+        }
+        a = _mm256_maddubs_epi16(a, weights);
+        b = _mm256_maddubs_epi16(b, weights);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i / 2), packed);
+    }
+
+    return i + hex_decode_ssse3(in + i, len - i, out + i / 2);
+}
+
+/* Map 6-bit indices to base64 characters. */
+__attribute__((target("ssse3")))
+static __m128i base64_translate_ssse3(__m128i indices, int url) {
+    const __m128i shift_lut = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        (url ? '-' : '+') - 62, (url ? '_' : '/') - 63, 'A', 0, 0);
+    __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+    return _mm_add_epi8(_mm_shuffle_epi8(shift_lut, result), indices);
+}
+
+/* Split each 3-byte group of the low 12 bytes into four 6-bit indices. */
+__attribute__((target("ssse3")))
+static __m128i base64_split_ssse3(__m128i v) {
+    v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+__attribute__((target("ssse3")))
+static size_t base64_encode_ssse3(const uint8_t *in, size_t len, uint8_t *out, int url) {
+    size_t i = 0, o = 0;
+
+    /* Loads are 16 bytes wide but only 12 are consumed. */
+    for (; i + 16 <= len; i += 12, o += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + o), base64_translate_ssse3(base64_split_ssse3(v), url));
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_encode_avx2(const uint8_t *in, size_t len, uint8_t *out, int url) {
+    const __m256i shuf = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    const __m256i shift_lut = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        (url ? '-' : '+') - 62, (url ? '_' : '/') - 63, 'A', 0, 0));
+    size_t i = 0, o = 0;
+
+    /* Each lane takes 12 bytes; the upper lane load reads 4 bytes past them. */
+    for (; i + 28 <= len; i += 24, o += 32) {
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(in + i))),
+            _mm_loadu_si128((const __m128i *)(in + i + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, result), indices);
+        _mm256_storeu_si256((__m256i *)(out + o), result);
+    }
+
+    return i + base64_encode_ssse3(in + i, len - i, out + o, url);
+}
+
+/* Standard alphabet only; base64url input is decoded by the scalar code. */
+__attribute__((target("ssse3")))
+static size_t base64_decode_ssse3(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m128i lut_lo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lut_hi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+    size_t i = 0, o = 0;
+
+    /* Stores are 16 bytes wide but only 12 are produced; the slack is
+     * covered by the output space reserved for the remaining input. */
+    for (; i + 24 <= len; i += 16, o += 12) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(v, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(v, mask_2f);
+        __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+        __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0) {
+            break;
+        }
+
+        __m128i eq_2f = _mm_cmpeq_epi8(v, mask_2f);
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+        v = _mm_add_epi8(v, roll);
+
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+        _mm_storeu_si128((__m128i *)(out + o), v);
+    }
+
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t base64_decode_avx2(const uint8_t *in, size_t len, uint8_t *out) {
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+        0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+        0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10));
+    const __m256i lut_roll = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0));
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+    size_t i = 0, o = 0;
+
+    for (; i + 48 <= len; i += 32, o += 24) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(v, mask_2f);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+
+        __m256i eq_2f = _mm256_cmpeq_epi8(v, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        v = _mm256_add_epi8(v, roll);
+
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        v = _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256((__m256i *)(out + o), v);
+    }
+
+    return i + base64_decode_ssse3(in + i, len - i, out + o);
+}
+
+#endif /* JBOTAN_CODEC_X86 */
+
+#if defined(JBOTAN_CODEC_NEON)
+
+static size_t hex_encode_neon(const uint8_t *in, size_t len, uint8_t *out) {
+    const uint8x16_t lut = vld1q_u8((const uint8_t *)codec_hex_chars);
+    size_t i = 0;
+
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t v = vld1q_u8(in + i);
+        uint8x16x2_t r;
+        r.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(v, 4));
+        r.val[1] = vqtbl1q_u8(lut, vandq_u8(v, vdupq_n_u8(0x0f)));
+        vst2q_u8(out + 2 * i, r);
+    }
+
+    return i;
+}
+
+/* Nibble values of 16 hex characters; lanes that are not hex digits are
+ * set to 0xff. */
+static uint8x16_t hex_decode_nibbles_neon(uint8x16_t v) {
+    uint8x16_t d = vsubq_u8(v, vdupq_n_u8('0'));
+    uint8x16_t l = vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+    uint8x16_t is_digit = vcleq_u8(d, vdupq_n_u8(9));
+    uint8x16_t is_alpha = vcleq_u8(l, vdupq_n_u8(5));
+    uint8x16_t value = vbslq_u8(is_digit, d, vaddq_u8(l, vdupq_n_u8(10)));
+    return vbslq_u8(vorrq_u8(is_digit, is_alpha), value, vdupq_n_u8(0xff));
+}
+
+static size_t hex_decode_neon(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        uint8x16x2_t v = vld2q_u8(in + i);
+        uint8x16_t hi = hex_decode_nibbles_neon(v.val[0]);
+        uint8x16_t lo = hex_decode_nibbles_neon(v.val[1]);
+        if (vmaxvq_u8(vorrq_u8(hi, lo)) > 0x0f) {
+            break;
+        }
+        vst1q_u8(out + i / 2, vorrq_u8(vshlq_n_u8(hi, 4), lo));
+    }
+
+    return i;
+}
+
+static size_t base64_encode_neon(const uint8_t *in, size_t len, uint8_t *out, int url) {
+    const uint8_t *chars = (const uint8_t *)codec_base64_chars[url ? 1 : 0];
+    uint8x16x4_t lut;
+    size_t i = 0, o = 0;
+
+    lut.val[0] = vld1q_u8(chars);
+    lut.val[1] = vld1q_u8(chars + 16);
+    lut.val[2] = vld1q_u8(chars + 32);
+    lut.val[3] = vld1q_u8(chars + 48);
+
+    for (; i + 48 <= len; i += 48, o += 64) {
+        uint8x16x3_t v = vld3q_u8(in + i);
+        uint8x16x4_t r;
+        r.val[0] = vshrq_n_u8(v.val[0], 2);
+        r.val[1] = vorrq_u8(vshlq_n_u8(vandq_u8(v.val[0], vdupq_n_u8(0x03)), 4),
+                            vshrq_n_u8(v.val[1], 4));
+        r.val[2] = vorrq_u8(vshlq_n_u8(vandq_u8(v.val[1], vdupq_n_u8(0x0f)), 2),
+                            vshrq_n_u8(v.val[2], 6));
+        r.val[3] = vandq_u8(v.val[2], vdupq_n_u8(0x3f));
+        r.val[0] = vqtbl4q_u8(lut, r.val[0]);
+        r.val[1] = vqtbl4q_u8(lut, r.val[1]);
+        r.val[2] = vqtbl4q_u8(lut, r.val[2]);
+        r.val[3] = vqtbl4q_u8(lut, r.val[3]);
+        vst4q_u8(out + o, r);
+    }
+
+    return i;
+}
+
+/* Sextet values of 16 standard base64 characters; lanes that are not part
+ * of the alphabet are set to 0xff. */
+static uint8x16_t base64_decode_sextets_neon(uint8x16_t v) {
+    uint8x16_t upper = vsubq_u8(v, vdupq_n_u8('A'));
+    uint8x16_t lower = vsubq_u8(v, vdupq_n_u8('a'));
+    uint8x16_t digit = vsubq_u8(v, vdupq_n_u8('0'));
+    uint8x16_t r = vdupq_n_u8(0xff);
+    r = vbslq_u8(vcltq_u8(upper, vdupq_n_u8(26)), upper, r);
+    r = vbslq_u8(vcltq_u8(lower, vdupq_n_u8(26)), vaddq_u8(lower, vdupq_n_u8(26)), r);
+    r = vbslq_u8(vcltq_u8(digit, vdupq_n_u8(10)), vaddq_u8(digit, vdupq_n_u8(52)), r);
+    r = vbslq_u8(vceqq_u8(v, vdupq_n_u8('+')), vdupq_n_u8(62), r);
+    r = vbslq_u8(vceqq_u8(v, vdupq_n_u8('/')), vdupq_n_u8(63), r);
+    return r;
+}
+
+static size_t base64_decode_neon(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0, o = 0;
+
+    for (; i + 64 <= len; i += 64, o += 48) {
+        uint8x16x4_t v = vld4q_u8(in + i);
+        uint8x16_t a = base64_decode_sextets_neon(v.val[0]);
+        uint8x16_t b = base64_decode_sextets_neon(v.val[1]);
+        uint8x16_t c = base64_decode_sextets_neon(v.val[2]);
+        uint8x16_t d = base64_decode_sextets_neon(v.val[3]);
+        if (vmaxvq_u8(vorrq_u8(vorrq_u8(a, b), vorrq_u8(c, d))) > 0x3f) {
+            break;
+        }
+
+        uint8x16x3_t r;
+        r.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        r.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        r.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(out + o, r);
+    }
+
+    return i;
+}
+
+#endif /* JBOTAN_CODEC_NEON */
+
+/* Codec entry points */
+
+/* `out` must have room for 2 * len bytes. */
+static void codec_hex_encode(const uint8_t *in, size_t len, uint8_t *out) {
+    size_t i = 0;
+
+    switch (codec_simd_level()) {
+#if defined(JBOTAN_CODEC_X86)
+        case CODEC_SIMD_AVX2:  i = hex_encode_avx2(in, len, out);  break;
+        case CODEC_SIMD_SSSE3: i = hex_encode_ssse3(in, len, out); break;
+#elif defined(JBOTAN_CODEC_NEON)
+        case CODEC_SIMD_NEON:  i = hex_encode_neon(in, len, out);  break;
+#endif
+        default: break;
+    }
+
+    for (; i < len; i++) {
+        out[2 * i] = codec_hex_chars[in[i] >> 4];
+        out[2 * i + 1] = codec_hex_chars[in[i] & 0x0f];
+    }
+}
+
+/* `out` must have room for len / 2 bytes. Returns BOTAN_FFI_SUCCESS and the
+ * decoded length in `out_len`, or BOTAN_FFI_ERROR_INVALID_INPUT. */
+static int codec_hex_decode(const uint8_t *in, size_t len, uint8_t *out, size_t *out_len) {
+    int level = codec_simd_level();
+    size_t i = 0, o = 0;
+    int half = -1;
+
+    while (i < len) {
+        if (half < 0 && level != CODEC_SIMD_NONE) {
+            size_t n = 0;
+            switch (level) {
+#if defined(JBOTAN_CODEC_X86)
+                case CODEC_SIMD_AVX2:  n = hex_decode_avx2(in + i, len - i, out + o);  break;
+                case CODEC_SIMD_SSSE3: n = hex_decode_ssse3(in + i, len - i, out + o); break;
+#elif defined(JBOTAN_CODEC_NEON)
+                case CODEC_SIMD_NEON:  n = hex_decode_neon(in + i, len - i, out + o);  break;
+#endif
+                default: break;
+            }
+            i += n;
+            o += n / 2;
+        }
+
+        /* Scalar code takes over up to the next 32 characters, such as a
+         * line break or the tail of the input. */
+        size_t stop = (len - i > 32) ? i + 32 : len;
+        for (; i < stop; i++) {
+            if (codec_is_space(in[i])) {
+                continue;
+            }
+            int v = codec_hex_value(in[i]);
+            if (v < 0) {
+                return BOTAN_FFI_ERROR_INVALID_INPUT;
+            }
+            if (half < 0) {
+                half = v;
+            } else {
+                out[o++] = (uint8_t)((half << 4) | v);
+                half = -1;
+            }
+        }
+    }
+
+    if (half >= 0) {
+        return BOTAN_FFI_ERROR_INVALID_INPUT;
+    }
+
+    *out_len = o;
+    return BOTAN_FFI_SUCCESS;
+}
+
+/* `out` must have room for codec_base64_encoded_len(len, padding) bytes. */
+static size_t codec_base64_encode(const uint8_t *in, size_t len, uint8_t *out,
+                                  int url, bool padding) {
+    const char *chars = codec_base64_chars[url ? 1 : 0];
+    size_t i = 0, o = 0;
+
+    switch (codec_simd_level()) {
+#if defined(JBOTAN_CODEC_X86)
+        case CODEC_SIMD_AVX2:  i = base64_encode_avx2(in, len, out, url);  break;
+        case CODEC_SIMD_SSSE3: i = base64_encode_ssse3(in, len, out, url); break;
+#elif defined(JBOTAN_CODEC_NEON)
+        case CODEC_SIMD_NEON:  i = base64_encode_neon(in, len, out, url);  break;
+#endif
+        default: break;
+    }
+    o = (i / 3) * 4;
+
+    for (; i + 3 <= len; i += 3) {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        out[o++] = chars[(v >> 18) & 0x3f];
+        out[o++] = chars[(v >> 12) & 0x3f];
+        out[o++] = chars[(v >> 6) & 0x3f];
+        out[o++] = chars[v & 0x3f];
+    }
+
+    if (i < len) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) {
+            v |= (uint32_t)in[i + 1] << 8;
+        }
+        out[o++] = chars[(v >> 18) & 0x3f];
+        out[o++] = chars[(v >> 12) & 0x3f];
+        if (i + 1 < len) {
+            out[o++] = chars[(v >> 6) & 0x3f];
+        } else if (padding) {
+            out[o++] = '=';
+        }
+        if (padding) {
+            out[o++] = '=';
+        }
+    }
+
+    return o;
+}
+
+/* `out` must have room for ((len + 3) / 4) * 3 bytes. Padding is optional.
+ * Returns BOTAN_FFI_SUCCESS and the decoded length in `out_len`, or
+ * BOTAN_FFI_ERROR_INVALID_INPUT. */
+static int codec_base64_decode(const uint8_t *in, size_t len, uint8_t *out,
+                               size_t *out_len, int url) {
+    int level = url ? CODEC_SIMD_NONE : codec_simd_level();
+    uint32_t quad = 0;
+    size_t i = 0, o = 0, q = 0, pad = 0;
+
+    while (i < len) {
+        if (q == 0 && pad == 0 && level != CODEC_SIMD_NONE) {
+            size_t n = 0;
+            switch (level) {
+#if defined(JBOTAN_CODEC_X86)
+                case CODEC_SIMD_AVX2:  n = base64_decode_avx2(in + i, len - i, out + o);  break;
+                case CODEC_SIMD_SSSE3: n = base64_decode_ssse3(in + i, len - i, out + o); break;
+#elif defined(JBOTAN_CODEC_NEON)
+                case CODEC_SIMD_NEON:  n = base64_decode_neon(in + i, len - i, out + o);  break;
+#endif
+                default: break;
+            }
+            i += n;
+            o += (n / 4) * 3;
+        }
+
+        size_t stop = (len - i > 64) ? i + 64 : len;
+        for (; i < stop; i++) {
+            if (codec_is_space(in[i])) {
+                continue;
+            }
+            if (in[i] == '=') {
+                if (q < 2 || q + pad >= 4) {
+                    return BOTAN_FFI_ERROR_INVALID_INPUT;
+                }
+                pad++;
+                continue;
+            }
+            int v = codec_base64_value(in[i], url);
+            if (v < 0 || pad > 0) {
+                return BOTAN_FFI_ERROR_INVALID_INPUT;
+            }
+            quad = (quad << 6) | (uint32_t)v;
+            if (++q == 4) {
+                out[o++] = (uint8_t)(quad >> 16);
+                out[o++] = (uint8_t)(quad >> 8);
+                out[o++] = (uint8_t)quad;
+                quad = 0;
+                q = 0;
+            }
+        }
+    }
+
+    if (q == 1 || (pad > 0 && q + pad != 4)) {
+        return BOTAN_FFI_ERROR_INVALID_INPUT;
+    }
+    if (q == 2) {
+        out[o++] = (uint8_t)(quad >> 4);
+    } else if (q == 3) {
+        out[o++] = (uint8_t)(quad >> 10);
+        out[o++] = (uint8_t)(quad >> 2);
+    }
+
+    *out_len = o;
+    return BOTAN_FFI_SUCCESS;
+}
+
+#endif /* BOTAN_CODEC_H */
@@ -0,0 +1,402 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_DERIVE_CACHE_H
+#define BOTAN_DERIVE_CACHE_H
+
+/*
+ * Derivation cache
+ *
+ * An opt-in, in-memory cache in front of `pbkdf`, `scrypt` and
+ * `bcrypt-is-valid`, for processes that stretch the same password with
+ * the same parameters over and over. Entries are looked up by an
+ * HMAC-SHA256 of the inputs under a random key chosen when the cache is
+ * enabled, so neither passwords nor unkeyed hashes of them are kept.
+ * Since the digests are uniformly distributed, their first bytes index a
+ * chained hash table directly. The cached outputs live in the secure
+ * arena and are wiped when evicted. The total size is bounded; the least
+ * recently used entry goes first. Nothing is ever written to disk.
+ */
+
+#define DERIVE_CACHE_DIGEST_LEN 32
+#define DERIVE_CACHE_MIN_BUCKETS 16
+
+typedef struct derive_cache_entry derive_cache_entry_t;
+
+struct derive_cache_entry {
+    derive_cache_entry_t *prev;
+    derive_cache_entry_t *next;
+    derive_cache_entry_t *chain;
+    uint8_t digest[DERIVE_CACHE_DIGEST_LEN];
+    uint8_t *value;
+    size_t len;
+    size_t capacity;
+};
+
+typedef struct derive_cache {
+    derive_cache_entry_t *head;
+    derive_cache_entry_t *tail;
+    derive_cache_entry_t **buckets;
+    size_t bucket_count;
+    botan_mac_t mac;
+    size_t max_bytes;
+    size_t bytes;
+    size_t entries;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} derive_cache_t;
+
+static derive_cache_t derive_cache;
+
+#ifdef JANET_WINDOWS
+static SRWLOCK derive_cache_lock = SRWLOCK_INIT;
+#define DERIVE_CACHE_LOCK()   AcquireSRWLockExclusive(&derive_cache_lock)
+#define DERIVE_CACHE_UNLOCK() ReleaseSRWLockExclusive(&derive_cache_lock)
+#else
+static pthread_mutex_t derive_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define DERIVE_CACHE_LOCK()   pthread_mutex_lock(&derive_cache_lock)
+#define DERIVE_CACHE_UNLOCK() pthread_mutex_unlock(&derive_cache_lock)
+#endif
+
+/* Called with the lock held. */
+static derive_cache_entry_t **derive_cache_bucket(const uint8_t digest[DERIVE_CACHE_DIGEST_LEN]) {
+    uint64_t h = 0;
+    for (int i = 0; i < 8; i++) {
+        h |= (uint64_t)digest[i] << (8 * i);
+    }
+    return &derive_cache.buckets[h & (derive_cache.bucket_count - 1)];
+}
+
+/* Called with the lock held. */
+static derive_cache_entry_t *derive_cache_find(const uint8_t digest[DERIVE_CACHE_DIGEST_LEN]) {
+    if (derive_cache.buckets == NULL) {
+        return NULL;
+    }
+    for (derive_cache_entry_t *e = *derive_cache_bucket(digest); e; e = e->chain) {
+        if (memcmp(e->digest, digest, DERIVE_CACHE_DIGEST_LEN) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Called with the lock held. Doubles the table once it holds more
+ * entries than buckets; if that fails the chains just get longer. */
+static bool derive_cache_grow(void) {
+    if (derive_cache.buckets != NULL && derive_cache.entries < derive_cache.bucket_count) {
+        return true;
+    }
+
+    size_t count = derive_cache.bucket_count ? derive_cache.bucket_count * 2
+                                             : DERIVE_CACHE_MIN_BUCKETS;
+    derive_cache_entry_t **buckets = janet_calloc(count, sizeof(derive_cache_entry_t *));
+    if (buckets == NULL) {
+        return derive_cache.buckets != NULL;
+    }
+
+    derive_cache_entry_t **old = derive_cache.buckets;
+    size_t old_count = derive_cache.bucket_count;
+    derive_cache.buckets = buckets;
+    derive_cache.bucket_count = count;
+    for (size_t i = 0; i < old_count; i++) {
+        derive_cache_entry_t *e = old[i];
+        while (e) {
+            derive_cache_entry_t *chain = e->chain;
+            derive_cache_entry_t **bucket = derive_cache_bucket(e->digest);
+            e->chain = *bucket;
+            *bucket = e;
+            e = chain;
+        }
+    }
+    janet_free(old);
+    return true;
+}
+
+/* Called with the lock held. */
+static void derive_cache_unchain(derive_cache_entry_t *e) {
+    derive_cache_entry_t **link = derive_cache_bucket(e->digest);
+    while (*link != e) {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+}
+
+/* Called with the lock held. */
+static void derive_cache_unlink(derive_cache_entry_t *e) {
+    if (e->prev) {
+        e->prev->next = e->next;
+    } else {
+        derive_cache.head = e->next;
+    }
+    if (e->next) {
+        e->next->prev = e->prev;
+    } else {
+        derive_cache.tail = e->prev;
+    }
+}
+
+/* Called with the lock held. */
+static void derive_cache_push_front(derive_cache_entry_t *e) {
+    e->prev = NULL;
+    e->next = derive_cache.head;
+    if (derive_cache.head) {
+        derive_cache.head->prev = e;
+    } else {
+        derive_cache.tail = e;
+    }
+    derive_cache.head = e;
+}
+
+/* Called with the lock held. */
+static void derive_cache_evict(derive_cache_entry_t *e) {
+    derive_cache_unchain(e);
+    derive_cache_unlink(e);
+    derive_cache.bytes -= e->capacity + sizeof(derive_cache_entry_t);
+    derive_cache.entries--;
+    secure_arena_free(e->value, e->capacity);
+    botan_scrub_mem(e, sizeof(derive_cache_entry_t));
+    janet_free(e);
+}
+
+/* Called with the lock held. */
+static void derive_cache_trim(size_t max_bytes) {
+    while (derive_cache.tail && derive_cache.bytes > max_bytes) {
+        derive_cache_evict(derive_cache.tail);
+        derive_cache.evictions++;
+    }
+}
+
+static int derive_cache_update_field(botan_mac_t mac, const uint8_t *data, size_t len) {
+    uint8_t prefix[8];
+    for (int i = 0; i < 8; i++) {
+        prefix[i] = (uint8_t)((uint64_t)len >> (8 * i));
+    }
+
+    int ret = botan_mac_update(mac, prefix, sizeof(prefix));
+    if (ret == 0) {
+        ret = botan_mac_update(mac, data, len);
+    }
+    return ret;
+}
+
+/* Computes the cache key of a derivation. `kind` and `algo` name the
+ * function, the numbers are its parameters. Returns false if the cache is
+ * disabled, in which case the caller skips it altogether. */
+static bool derive_cache_digest(uint8_t digest[DERIVE_CACHE_DIGEST_LEN],
+                                const char *kind, const char *algo,
+                                size_t p1, size_t p2, size_t p3, size_t out_len,
+                                JanetByteView password, JanetByteView salt) {
+    uint8_t params[32];
+    size_t values[4] = {p1, p2, p3, out_len};
+    for (int i = 0; i < 4; i++) {
+        for (int k = 0; k < 8; k++) {
+            params[8 * i + k] = (uint8_t)((uint64_t)values[i] >> (8 * k));
+        }
+    }
+
+    DERIVE_CACHE_LOCK();
+    if (derive_cache.max_bytes == 0) {
+        DERIVE_CACHE_UNLOCK();
+        return false;
+    }
+
+    botan_mac_t mac = derive_cache.mac;
+    int ret = derive_cache_update_field(mac, (const uint8_t *)kind, strlen(kind));
+    if (ret == 0) {
+        ret = derive_cache_update_field(mac, (const uint8_t *)algo, strlen(algo));
+    }
+    if (ret == 0) {
+        ret = derive_cache_update_field(mac, params, sizeof(params));
+    }
+    if (ret == 0) {
+        ret = derive_cache_update_field(mac, password.bytes, password.len);
+    }
+    if (ret == 0) {
+        ret = derive_cache_update_field(mac, salt.bytes, salt.len);
+    }
+    if (ret == 0) {
+        ret = botan_mac_final(mac, digest);
+    }
+    DERIVE_CACHE_UNLOCK();
+
+    return ret == 0;
+}
+
+/* Copies the cached value for `digest` into `out` if there is one of
+ * exactly `len` bytes. */
+static bool derive_cache_get(const uint8_t digest[DERIVE_CACHE_DIGEST_LEN],
+                             uint8_t *out, size_t len) {
+    DERIVE_CACHE_LOCK();
+    derive_cache_entry_t *e = derive_cache_find(digest);
+    if (e != NULL && e->len == len) {
+        memcpy(out, e->value, len);
+        derive_cache_unlink(e);
+        derive_cache_push_front(e);
+        derive_cache.hits++;
+        DERIVE_CACHE_UNLOCK();
+        return true;
+    }
+    derive_cache.misses++;
+    DERIVE_CACHE_UNLOCK();
+    return false;
+}
+
+/* Stores `len` bytes of `value` under `digest`. Values that do not fit
+ * are simply not cached. */
+static void derive_cache_put(const uint8_t digest[DERIVE_CACHE_DIGEST_LEN],
+                             const uint8_t *value, size_t len) {
+    size_t capacity;
+    uint8_t *copy = secure_arena_alloc(len, &capacity);
+    if (copy == NULL) {
+        return;
+    }
+    memcpy(copy, value, len);
+
+    derive_cache_entry_t *e = janet_malloc(sizeof(derive_cache_entry_t));
+    if (e == NULL) {
+        secure_arena_free(copy, capacity);
+        return;
+    }
+    memcpy(e->digest, digest, DERIVE_CACHE_DIGEST_LEN);
+    e->value = copy;
+    e->len = len;
+    e->capacity = capacity;
+
+    DERIVE_CACHE_LOCK();
+    size_t cost = capacity + sizeof(derive_cache_entry_t);
+    if (cost > derive_cache.max_bytes) {
+        DERIVE_CACHE_UNLOCK();
+        secure_arena_free(copy, capacity);
+        janet_free(e);
+        return;
+    }
+
+    derive_cache_entry_t *old = derive_cache_find(digest);
+    if (old != NULL) {
+        derive_cache_evict(old);
+    }
+    derive_cache_trim(derive_cache.max_bytes - cost);
+    if (!derive_cache_grow()) {
+        DERIVE_CACHE_UNLOCK();
+        secure_arena_free(copy, capacity);
+        janet_free(e);
+        return;
+    }
+    derive_cache_entry_t **bucket = derive_cache_bucket(digest);
+    e->chain = *bucket;
+    *bucket = e;
+    derive_cache_push_front(e);
+    derive_cache.bytes += cost;
+    derive_cache.entries++;
+    DERIVE_CACHE_UNLOCK();
+}
+
+/* Called with the lock held. Keys the cache HMAC with fresh randomness,
+ * which also makes every existing entry unreachable. */
+static int derive_cache_rekey(void) {
+    uint8_t key[32];
+    botan_rng_t rng;
+    int ret;
+
+    if (derive_cache.mac == NULL) {
+        ret = botan_mac_init(&derive_cache.mac, "HMAC(SHA-256)", 0);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+
+    ret = botan_rng_init(&rng, "system");
+    if (ret != 0) {
+        return ret;
+    }
+    ret = botan_rng_get(rng, key, sizeof(key));
+    botan_rng_destroy(rng);
+    if (ret == 0) {
+        ret = botan_mac_set_key(derive_cache.mac, key, sizeof(key));
+    }
+    botan_scrub_mem(key, sizeof(key));
+    return ret;
+}
+
+static Janet derive_cache_stats_struct(void) {
+    DERIVE_CACHE_LOCK();
+    derive_cache_t cache = derive_cache;
+    DERIVE_CACHE_UNLOCK();
+
+    JanetKV *st = janet_struct_begin(6);
+    janet_struct_put(st, janet_ckeywordv("max-bytes"), janet_wrap_number((double)cache.max_bytes));
+    janet_struct_put(st, janet_ckeywordv("bytes"), janet_wrap_number((double)cache.bytes));
+    janet_struct_put(st, janet_ckeywordv("entries"), janet_wrap_number((double)cache.entries));
+    janet_struct_put(st, janet_ckeywordv("hits"), janet_wrap_number((double)cache.hits));
+    janet_struct_put(st, janet_ckeywordv("misses"), janet_wrap_number((double)cache.misses));
+    janet_struct_put(st, janet_ckeywordv("evictions"), janet_wrap_number((double)cache.evictions));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+/* Janet functions */
+static Janet derive_cache_configure(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+    size_t max_bytes = janet_getsize(argv, 0);
+
+    DERIVE_CACHE_LOCK();
+    if (max_bytes > 0 && derive_cache.max_bytes == 0) {
+        int ret = derive_cache_rekey();
+        if (ret != 0) {
+            DERIVE_CACHE_UNLOCK();
+            janet_panic(getBotanError(ret));
+        }
+    }
+    derive_cache.max_bytes = max_bytes;
+    derive_cache_trim(max_bytes);
+    DERIVE_CACHE_UNLOCK();
+
+    return derive_cache_stats_struct();
+}
+
+static Janet derive_cache_clear(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 0);
+
+    DERIVE_CACHE_LOCK();
+    derive_cache_trim(0);
+    DERIVE_CACHE_UNLOCK();
+
+    return janet_wrap_nil();
+}
+
+static Janet derive_cache_stats(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 0);
+    return derive_cache_stats_struct();
+}
+
+static JanetReg derive_cache_cfuns[] = {
+    {"derive-cache/configure", derive_cache_configure,
+     "(derive-cache/configure max-bytes)\n\n"
+     "Enable the in-memory cache of `pbkdf` (with an explicit salt), "
+     "`scrypt` and `bcrypt-is-valid` results, including those of their "
+     "`-async` variants, using at most `max-bytes` of memory, or disable "
+     "and wipe it with 0. The cache is disabled by default. Entries are keyed by a keyed hash of the password, salt and "
+     "parameters, held in secure memory, wiped when evicted and never "
+     "persisted. Returns the same struct as `derive-cache/stats`."
+    },
+    {"derive-cache/clear", derive_cache_clear,
+     "(derive-cache/clear)\n\n"
+     "Wipe every cached result."
+    },
+    {"derive-cache/stats", derive_cache_stats,
+     "(derive-cache/stats)\n\n"
+     "Returns a struct of the cache limit `:max-bytes`, the `:bytes` and "
+     "`:entries` in use, and the `:hits`, `:misses` and `:evictions` "
+     "counters."
+    },
+    {NULL, NULL, NULL}
+};
+
+static void submod_derive_cache(JanetTable *env) {
+    janet_cfuns(env, "botan", derive_cache_cfuns);
+}
+
+#endif /* BOTAN_DERIVE_CACHE_H */
@@ -9,6 +9,7 @@
 
 typedef struct botan_hotp_obj {
     botan_hotp_t hotp;
+    uint32_t modulus;
 } botan_hotp_obj_t;
 
 /* Abstract Object functions */
@@ -19,6 +20,7 @@ static int hotp_get_fn(void *data, Janet key, Janet *out);
 static Janet hotp_new(int32_t argc, Janet *argv);
 static Janet hotp_generate(int32_t argc, Janet *argv);
 static Janet hotp_check(int32_t argc, Janet *argv);
+static Janet hotp_check_many(int32_t argc, Janet *argv);
 
 static JanetAbstractType hotp_obj_type = {
     "botan/hotp",
@@ -38,6 +40,25 @@ static JanetAbstractType *get_hotp_obj_type() {
     return &hotp_obj_type;
 }
 
+/* Code helpers, shared with TOTP */
+
+/* 10^digits, for the 6 to 8 digits HOTP and TOTP allow. */
+static uint32_t hotp_modulus(size_t digits) {
+    return digits == 6 ? 1000000 : digits == 7 ? 10000000 : 100000000;
+}
+
+/* Reads the code at `n`. Returns false if it has more digits than the
+ * codes it is compared with, as no such code can be correct; casting it
+ * down would instead make a few of them collide with real codes. */
+static bool hotp_getcode(const Janet *argv, int32_t n, uint32_t modulus, uint32_t *code) {
+    size_t value = janet_getsize(argv, n);
+    if (value >= modulus) {
+        return false;
+    }
+    *code = (uint32_t)value;
+    return true;
+}
+
 /* Abstract Object functions */
 static int hotp_gc_fn(void *data, size_t len) {
     botan_hotp_obj_t *obj = (botan_hotp_obj_t *)data;
@@ -71,6 +92,8 @@ static Janet hotp_new(int32_t argc, Janet *argv) {
     int ret = botan_hotp_init(&obj->hotp, key.bytes, key.len, hash, digits);
     JANET_BOTAN_ASSERT(ret);
 
+    obj->modulus = hotp_modulus(digits);
+
     return janet_wrap_abstract(obj);
 }
 
@@ -93,13 +116,17 @@ static Janet hotp_check(int32_t argc, Janet *argv) {
 
     botan_hotp_obj_t *obj = janet_getabstract(argv, 0, get_hotp_obj_type());
     botan_hotp_t hotp = obj->hotp;
-    uint32_t code = (uint32_t)janet_getsize(argv, 1);
+    uint32_t code;
+    bool in_range = hotp_getcode(argv, 1, obj->modulus, &code);
     uint64_t counter = janet_getuinteger64(argv, 2);
     size_t resync_range = janet_optsize(argv, argc, 3, 0);
 
     uint64_t next_ctr = 0;
-    int ret = botan_hotp_check(hotp, &next_ctr, code, counter, resync_range);
-    JANET_BOTAN_ASSERT(ret);
+    int ret = 1;
+    if (in_range) {
+        ret = botan_hotp_check(hotp, &next_ctr, code, counter, resync_range);
+        JANET_BOTAN_ASSERT(ret);
+    }
 
     Janet result[2];
     if (ret == 0) {
@@ -113,6 +140,49 @@ static Janet hotp_check(int32_t argc, Janet *argv) {
     return janet_wrap_tuple(janet_tuple_n(result, 2));
 }
 
+static Janet hotp_check_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 2);
+
+    JanetView items = janet_getindexed(argv, 0);
+    size_t resync_range = janet_optsize(argv, argc, 1, 0);
+
+    for (int32_t i = 0; i < items.len; i++) {
+        const Janet *entry;
+        int32_t entry_len;
+        if (!janet_indexed_view(items.items[i], &entry, &entry_len) || entry_len != 3 ||
+            !janet_checkabstract(entry[0], get_hotp_obj_type()) ||
+            !janet_checksize(entry[1])) {
+            janet_panicf("expected [hotp code counter] at index %d, got %v", i, items.items[i]);
+        }
+        janet_getuinteger64(entry, 2);
+    }
+
+    JanetArray *results = janet_array(items.len);
+    for (int32_t i = 0; i < items.len; i++) {
+        const Janet *entry;
+        int32_t entry_len;
+        janet_indexed_view(items.items[i], &entry, &entry_len);
+        botan_hotp_obj_t *obj = janet_unwrap_abstract(entry[0]);
+        uint32_t code;
+        bool in_range = hotp_getcode(entry, 1, obj->modulus, &code);
+        uint64_t counter = janet_getuinteger64(entry, 2);
+
+        uint64_t next_ctr = 0;
+        int ret = 1;
+        if (in_range) {
+            ret = botan_hotp_check(obj->hotp, &next_ctr, code, counter, resync_range);
+            JANET_BOTAN_ASSERT(ret);
+        }
+
+        Janet result[2];
+        result[0] = janet_wrap_boolean(ret == 0);
+        result[1] = janet_wrap_number((double)(ret == 0 ? next_ctr : counter));
+        janet_array_push(results, janet_wrap_tuple(janet_tuple_n(result, 2)));
+    }
+
+    return janet_wrap_array(results);
+}
+
 static JanetReg hotp_cfuns[] = {
     {"hotp/new", hotp_new,
      "(hotp/new key &opt hash digits)\n\n"
@@ -134,7 +204,15 @@ static JanetReg hotp_cfuns[] = {
      "counter value that should be used. If the `code` did not verify, the "
      "next counter value is always identical to the counter that was passed "
      "in. If the `code` did verify and `resync-range` was zero, then the next "
-     "counter will always be counter+1."
+     "counter will always be counter+1. A `code` with more than `digits` "
+     "digits never verifies."
+    },
+    {"hotp/check-many", hotp_check_many,
+     "(hotp/check-many items &opt resync-range)\n\n"
+     "Check many codes at once. `items` is an indexed collection of "
+     "`[hotp-obj code counter]` entries, each checked as by `hotp/check` "
+     "with the same `resync-range`. Returns an array of (boolean number) "
+     "tuples in the order of `items`."
     },
 
     {NULL, NULL, NULL}
@@ -0,0 +1,426 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_HYBRID_KEM_H
+#define BOTAN_HYBRID_KEM_H
+
+/*
+ * Hybrid KEM
+ *
+ * Combines a classical key agreement (X25519 or X448) with a KEM such as
+ * ML-KEM, so that the shared key stays secret as long as either of them
+ * holds. The sender makes an ephemeral key pair, agrees with the
+ * receiver's public value and encapsulates to the receiver's KEM key. The
+ * ciphertext is the ephemeral public value followed by the encapsulated
+ * key. Both sides then derive the shared key with
+ *
+ *   kdf(kem-secret || ecdh-secret, salt,
+ *       ephemeral-public-value || receiver-public-value || encapsulated-key)
+ *
+ * The label binds the whole ciphertext, so the construction does not rely
+ * on the KEM secret already depending on the encapsulated key, which
+ * ML-KEM guarantees but not every KEM does. The operators are created
+ * once with the object and keep the key objects alive; all intermediate
+ * secrets are kept on the stack and wiped after use.
+ */
+
+#define HYBRID_KEM_MAX_VALUE 64
+#define HYBRID_KEM_MAX_SECRET 64
+#define HYBRID_KEM_KDF_LEN 64
+
+typedef struct botan_hybrid_kem_obj {
+    Janet ecdh_key;
+    Janet kem_key;
+    bool is_receiver;
+    char ecdh_algo[16];
+    char kdf[HYBRID_KEM_KDF_LEN];
+    uint8_t ecdh_public[HYBRID_KEM_MAX_VALUE];
+    size_t ecdh_public_len;
+    size_t ecdh_secret_len;
+    size_t kem_secret_len;
+    size_t kem_ciphertext_len;
+    botan_pk_op_ka_t ka;
+    botan_pk_op_kem_encrypt_t kem_encrypt;
+    botan_pk_op_kem_decrypt_t kem_decrypt;
+    botan_rng_t rng;
+} botan_hybrid_kem_obj_t;
+
+/* Abstract Object functions */
+static int hybrid_kem_gc_fn(void *data, size_t len);
+static int hybrid_kem_gcmark_fn(void *data, size_t len);
+static int hybrid_kem_get_fn(void *data, Janet key, Janet *out);
+
+/* Janet functions */
+static Janet hybrid_kem_new(int32_t argc, Janet *argv);
+static Janet hybrid_kem_ciphertext_length(int32_t argc, Janet *argv);
+static Janet hybrid_kem_encapsulate(int32_t argc, Janet *argv);
+static Janet hybrid_kem_decapsulate(int32_t argc, Janet *argv);
+
+static JanetAbstractType hybrid_kem_obj_type = {
+    "botan/hybrid-kem",
+    hybrid_kem_gc_fn,
+    hybrid_kem_gcmark_fn,
+    hybrid_kem_get_fn,
+    JANET_ATEND_GET
+};
+
+static JanetMethod hybrid_kem_methods[] = {
+    {"ciphertext-length", hybrid_kem_ciphertext_length},
+    {"encapsulate", hybrid_kem_encapsulate},
+    {"decapsulate", hybrid_kem_decapsulate},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_hybrid_kem_obj_type() {
+    return &hybrid_kem_obj_type;
+}
+
+/* Abstract Object functions */
+static int hybrid_kem_gc_fn(void *data, size_t len) {
+    botan_hybrid_kem_obj_t *obj = (botan_hybrid_kem_obj_t *)data;
+
+    botan_pk_op_key_agreement_destroy(obj->ka);
+    botan_pk_op_kem_encrypt_destroy(obj->kem_encrypt);
+    botan_pk_op_kem_decrypt_destroy(obj->kem_decrypt);
+    botan_rng_destroy(obj->rng);
+
+    return 0;
+}
+
+static int hybrid_kem_gcmark_fn(void *data, size_t len) {
+    botan_hybrid_kem_obj_t *obj = (botan_hybrid_kem_obj_t *)data;
+    janet_mark(obj->ecdh_key);
+    janet_mark(obj->kem_key);
+    return 0;
+}
+
+static int hybrid_kem_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), hybrid_kem_methods, out);
+}
+
+/* Helpers */
+
+typedef struct hybrid_kem_view {
+    uint8_t *out;
+    size_t capacity;
+    size_t len;
+} hybrid_kem_view_t;
+
+/* Copies a viewed value into a fixed buffer instead of scratch memory. */
+static int hybrid_kem_view_func(botan_view_ctx view_ctx, const uint8_t *bin, size_t len) {
+    hybrid_kem_view_t *view = (hybrid_kem_view_t *)view_ctx;
+    if (!view || !bin) {
+        return BOTAN_FFI_ERROR_NULL_POINTER;
+    }
+    if (len > view->capacity) {
+        return BOTAN_FFI_ERROR_INSUFFICIENT_BUFFER_SPACE;
+    }
+
+    memcpy(view->out, bin, len);
+    view->len = len;
+    return 0;
+}
+
+static void hybrid_kem_check_ecdh_algo(const char *algo) {
+    if (strcmp(algo, "X25519") != 0 && strcmp(algo, "X448") != 0) {
+        janet_panicf("expected an X25519 or X448 key, got %s", algo);
+    }
+}
+
+static void hybrid_kem_init_receiver(botan_hybrid_kem_obj_t *obj,
+                                     botan_privkey_t ecdh, botan_privkey_t kem) {
+    size_t algo_len = sizeof(obj->ecdh_algo);
+    int ret = botan_privkey_algo_name(ecdh, obj->ecdh_algo, &algo_len);
+    JANET_BOTAN_ASSERT(ret);
+    hybrid_kem_check_ecdh_algo(obj->ecdh_algo);
+
+    ret = botan_pk_op_key_agreement_create(&obj->ka, ecdh, "Raw", 0);
+    JANET_BOTAN_ASSERT(ret);
+
+    hybrid_kem_view_t view = {obj->ecdh_public, sizeof(obj->ecdh_public), 0};
+    ret = botan_pk_op_key_agreement_view_public(ecdh, &view, (botan_view_bin_fn)hybrid_kem_view_func);
+    JANET_BOTAN_ASSERT(ret);
+    obj->ecdh_public_len = view.len;
+
+    ret = botan_pk_op_key_agreement_size(obj->ka, &obj->ecdh_secret_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_pk_op_kem_decrypt_create(&obj->kem_decrypt, kem, "Raw");
+    JANET_BOTAN_ASSERT(ret);
+    ret = botan_pk_op_kem_decrypt_shared_key_length(obj->kem_decrypt, 32, &obj->kem_secret_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    /* The encapsulated key length is only exposed on the encrypt side. */
+    botan_pubkey_t kem_pub = NULL;
+    botan_pk_op_kem_encrypt_t probe = NULL;
+    ret = botan_privkey_export_pubkey(&kem_pub, kem);
+    if (ret == 0) {
+        ret = botan_pk_op_kem_encrypt_create(&probe, kem_pub, "Raw");
+    }
+    if (ret == 0) {
+        ret = botan_pk_op_kem_encrypt_encapsulated_key_length(probe, &obj->kem_ciphertext_len);
+    }
+    botan_pk_op_kem_encrypt_destroy(probe);
+    botan_pubkey_destroy(kem_pub);
+    JANET_BOTAN_ASSERT(ret);
+}
+
+static void hybrid_kem_init_sender(botan_hybrid_kem_obj_t *obj,
+                                   botan_pubkey_t ecdh, botan_pubkey_t kem) {
+    size_t algo_len = sizeof(obj->ecdh_algo);
+    int ret = botan_pubkey_algo_name(ecdh, obj->ecdh_algo, &algo_len);
+    JANET_BOTAN_ASSERT(ret);
+    hybrid_kem_check_ecdh_algo(obj->ecdh_algo);
+
+    hybrid_kem_view_t view = {obj->ecdh_public, sizeof(obj->ecdh_public), 0};
+    ret = botan_pubkey_view_raw(ecdh, &view, (botan_view_bin_fn)hybrid_kem_view_func);
+    JANET_BOTAN_ASSERT(ret);
+    obj->ecdh_public_len = view.len;
+    obj->ecdh_secret_len = view.len;
+
+    ret = botan_pk_op_kem_encrypt_create(&obj->kem_encrypt, kem, "Raw");
+    JANET_BOTAN_ASSERT(ret);
+    ret = botan_pk_op_kem_encrypt_shared_key_length(obj->kem_encrypt, 32, &obj->kem_secret_len);
+    JANET_BOTAN_ASSERT(ret);
+    ret = botan_pk_op_kem_encrypt_encapsulated_key_length(obj->kem_encrypt, &obj->kem_ciphertext_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_rng_init(&obj->rng, "system");
+    JANET_BOTAN_ASSERT(ret);
+}
+
+/* Runs the combiner. `secret` holds the KEM secret followed by the ECDH
+ * secret, and `ciphertext` is the hybrid ciphertext. */
+static int hybrid_kem_combine(botan_hybrid_kem_obj_t *obj,
+                              const uint8_t *secret, const uint8_t *ciphertext,
+                              JanetByteView salt, uint8_t *out, size_t out_len) {
+    size_t pub_len = obj->ecdh_public_len;
+    size_t label_len = 2 * pub_len + obj->kem_ciphertext_len;
+    uint8_t *label = janet_smalloc(label_len);
+    memcpy(label, ciphertext, pub_len);
+    memcpy(label + pub_len, obj->ecdh_public, pub_len);
+    memcpy(label + 2 * pub_len, ciphertext + pub_len, obj->kem_ciphertext_len);
+
+    int ret = botan_kdf(obj->kdf, out, out_len,
+                        secret, obj->kem_secret_len + obj->ecdh_secret_len,
+                        salt.bytes, salt.len,
+                        label, label_len);
+    janet_sfree(label);
+    return ret;
+}
+
+/* Janet functions */
+static Janet hybrid_kem_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+
+    const char *kdf = janet_optcstring(argv, argc, 2, "HKDF(SHA-256)");
+    if (strlen(kdf) >= HYBRID_KEM_KDF_LEN) {
+        janet_panic("KDF name too long");
+    }
+
+    botan_private_key_obj_t *ecdh_priv = janet_checkabstract(argv[0], get_private_key_obj_type());
+    botan_public_key_obj_t *ecdh_pub = janet_checkabstract(argv[0], get_public_key_obj_type());
+    if (ecdh_priv == NULL && ecdh_pub == NULL) {
+        janet_panicf("expected private or public key, got %v", argv[0]);
+    }
+
+    botan_hybrid_kem_obj_t *obj = janet_abstract(&hybrid_kem_obj_type, sizeof(botan_hybrid_kem_obj_t));
+    memset(obj, 0, sizeof(botan_hybrid_kem_obj_t));
+    obj->ecdh_key = argv[0];
+    obj->kem_key = argv[1];
+    memcpy(obj->kdf, kdf, strlen(kdf) + 1);
+
+    if (ecdh_priv) {
+        botan_private_key_obj_t *kem = janet_getabstract(argv, 1, get_private_key_obj_type());
+        obj->is_receiver = true;
+        hybrid_kem_init_receiver(obj, ecdh_priv->private_key, kem->private_key);
+    } else {
+        botan_public_key_obj_t *kem = janet_getabstract(argv, 1, get_public_key_obj_type());
+        hybrid_kem_init_sender(obj, ecdh_pub->public_key, kem->public_key);
+    }
+
+    if (obj->ecdh_secret_len > HYBRID_KEM_MAX_SECRET ||
+        obj->kem_secret_len > HYBRID_KEM_MAX_SECRET) {
+        janet_panic("shared secret too large for hybrid-kem");
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet hybrid_kem_ciphertext_length(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+
+    botan_hybrid_kem_obj_t *obj = janet_getabstract(argv, 0, get_hybrid_kem_obj_type());
+    return janet_wrap_number((double)(obj->ecdh_public_len + obj->kem_ciphertext_len));
+}
+
+static Janet hybrid_kem_encapsulate(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+
+    botan_hybrid_kem_obj_t *obj = janet_getabstract(argv, 0, get_hybrid_kem_obj_type());
+    JanetByteView salt = janet_getbytes(argv, 1);
+    size_t key_len = janet_getsize(argv, 2);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 3);
+    if (obj->is_receiver) {
+        janet_panic("hybrid-kem made from private keys cannot encapsulate");
+    }
+    if (key_len > INT32_MAX) {
+        janet_panic("Output too large");
+    }
+
+    size_t ciphertext_len = obj->ecdh_public_len + obj->kem_ciphertext_len;
+    uint8_t *ciphertext = janet_string_begin((int32_t)ciphertext_len);
+    uint8_t *out = secure_out
+        ? secure_buffer_reserve(secure_out, key_len)
+        : janet_string_begin((int32_t)key_len);
+
+    uint8_t secret[2 * HYBRID_KEM_MAX_SECRET];
+    size_t secret_len = sizeof(secret);
+    botan_privkey_t ephemeral = NULL;
+    botan_pk_op_ka_t ka = NULL;
+
+    /* Ephemeral key agreement, writing the ephemeral public value at the
+     * start of the ciphertext. */
+    int ret = botan_privkey_create(&ephemeral, obj->ecdh_algo, "", obj->rng);
+    if (ret == 0) {
+        ret = botan_pk_op_key_agreement_create(&ka, ephemeral, "Raw", 0);
+    }
+    if (ret == 0) {
+        hybrid_kem_view_t view = {ciphertext, obj->ecdh_public_len, 0};
+        ret = botan_pk_op_key_agreement_view_public(ephemeral, &view, (botan_view_bin_fn)hybrid_kem_view_func);
+    }
+    if (ret == 0) {
+        secret_len = obj->ecdh_secret_len;
+        ret = botan_pk_op_key_agreement(ka, secret + obj->kem_secret_len, &secret_len,
+                                        obj->ecdh_public, obj->ecdh_public_len, NULL, 0);
+    }
+    botan_pk_op_key_agreement_destroy(ka);
+    botan_privkey_destroy(ephemeral);
+
+    if (ret == 0) {
+        size_t kem_secret_len = obj->kem_secret_len;
+        size_t kem_ciphertext_len = obj->kem_ciphertext_len;
+        ret = botan_pk_op_kem_encrypt_create_shared_key(
+            obj->kem_encrypt, obj->rng, NULL, 0, obj->kem_secret_len,
+            secret, &kem_secret_len,
+            ciphertext + obj->ecdh_public_len, &kem_ciphertext_len);
+    }
+    if (ret == 0) {
+        ret = hybrid_kem_combine(obj, secret, ciphertext, salt, out, key_len);
+    }
+    botan_scrub_mem(secret, sizeof(secret));
+    if (ret != 0) {
+        botan_scrub_mem(out, key_len);
+        janet_panic(getBotanError(ret));
+    }
+
+    Janet result[2];
+    if (secure_out) {
+        secure_buffer_commit(secure_out, key_len);
+        result[0] = janet_wrap_abstract(secure_out);
+    } else {
+        result[0] = janet_wrap_string(janet_string_end(out));
+    }
+    result[1] = janet_wrap_string(janet_string_end(ciphertext));
+    return janet_wrap_tuple(janet_tuple_n(result, 2));
+}
+
+static Janet hybrid_kem_decapsulate(int32_t argc, Janet *argv) {
+    janet_arity(argc, 4, 5);
+
+    botan_hybrid_kem_obj_t *obj = janet_getabstract(argv, 0, get_hybrid_kem_obj_type());
+    JanetByteView ciphertext = janet_getbytes(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+    size_t key_len = janet_getsize(argv, 3);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
+    if (!obj->is_receiver) {
+        janet_panic("hybrid-kem made from public keys cannot decapsulate");
+    }
+    if (key_len > INT32_MAX) {
+        janet_panic("Output too large");
+    }
+    if ((size_t)ciphertext.len != obj->ecdh_public_len + obj->kem_ciphertext_len) {
+        janet_panicf("expected a %d byte ciphertext, got %d bytes",
+                     (int)(obj->ecdh_public_len + obj->kem_ciphertext_len), ciphertext.len);
+    }
+
+    uint8_t *out = secure_out
+        ? secure_buffer_reserve(secure_out, key_len)
+        : janet_string_begin((int32_t)key_len);
+
+    uint8_t secret[2 * HYBRID_KEM_MAX_SECRET];
+    size_t ecdh_secret_len = obj->ecdh_secret_len;
+    size_t kem_secret_len = obj->kem_secret_len;
+
+    int ret = botan_pk_op_key_agreement(obj->ka, secret + obj->kem_secret_len, &ecdh_secret_len,
+                                        ciphertext.bytes, obj->ecdh_public_len, NULL, 0);
+    if (ret == 0) {
+        ret = botan_pk_op_kem_decrypt_shared_key(obj->kem_decrypt, NULL, 0,
+                                                 ciphertext.bytes + obj->ecdh_public_len,
+                                                 obj->kem_ciphertext_len,
+                                                 obj->kem_secret_len,
+                                                 secret, &kem_secret_len);
+    }
+    if (ret == 0) {
+        ret = hybrid_kem_combine(obj, secret, ciphertext.bytes, salt, out, key_len);
+    }
+    botan_scrub_mem(secret, sizeof(secret));
+    if (ret != 0) {
+        botan_scrub_mem(out, key_len);
+        janet_panic(getBotanError(ret));
+    }
+
+    if (secure_out) {
+        secure_buffer_commit(secure_out, key_len);
+        return janet_wrap_abstract(secure_out);
+    }
+    return janet_wrap_string(janet_string_end(out));
+}
+
+static JanetReg hybrid_kem_cfuns[] = {
+    {"hybrid-kem/new", hybrid_kem_new,
+     "(hybrid-kem/new ecdh-key kem-key &opt kdf)\n\n"
+     "Create a hybrid KEM combining an X25519 or X448 key with a KEM key "
+     "such as ML-KEM. Given the receiver's two public keys, the object "
+     "encapsulates; given the receiver's two private keys, it "
+     "decapsulates. The shared key is derived with `kdf` (default "
+     "\"HKDF(SHA-256)\") from the KEM secret followed by the ECDH secret, "
+     "with the ephemeral public value, the receiver's public value and the "
+     "encapsulated key as the label. Returns `hybrid-kem-obj`."
+    },
+    {"hybrid-kem/ciphertext-length", hybrid_kem_ciphertext_length,
+     "(hybrid-kem/ciphertext-length hybrid-kem-obj)\n\n"
+     "Returns the length of a hybrid ciphertext: the ephemeral public value "
+     "followed by the encapsulated key."
+    },
+    {"hybrid-kem/encapsulate", hybrid_kem_encapsulate,
+     "(hybrid-kem/encapsulate hybrid-kem-obj salt key-len &opt out)\n\n"
+     "Make a fresh shared key of `key-len` bytes for the receiver. Returns "
+     "the tuple of (shared-key, ciphertext). If the secure buffer `out` is "
+     "given, the shared key is written into it and it takes the key's "
+     "place in the tuple."
+    },
+    {"hybrid-kem/decapsulate", hybrid_kem_decapsulate,
+     "(hybrid-kem/decapsulate hybrid-kem-obj ciphertext salt key-len &opt out)\n\n"
+     "Recover the shared key of `key-len` bytes from `ciphertext`. Returns "
+     "the shared key, or writes it into the secure buffer `out` and returns "
+     "`out`."
+    },
+
+    {NULL, NULL, NULL}
+};
+
+static void submod_hybrid_kem(JanetTable *env) {
+    janet_cfuns(env, "botan", hybrid_kem_cfuns);
+    janet_register_abstract_type(get_hybrid_kem_obj_type());
+}
+
+#endif /* BOTAN_HYBRID_KEM_H */
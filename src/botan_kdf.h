@@ -7,21 +7,174 @@
 #ifndef BOTAN_KDF_H
 #define BOTAN_KDF_H
 
+/*
+ * HKDF
+ *
+ * The FFI only offers one-shot KDF calls that parse the algorithm name
+ * every time. HKDF is therefore also implemented here on top of an HMAC
+ * object (RFC 5869): extracting keys the HMAC with the PRK, and each
+ * expand after that only runs the HMAC.
+ */
+
+#define HKDF_MAC_NAME_LEN 128
+
+/* Writes the name of the HMAC used by "HKDF(<prf>)" into `mac_name`.
+ * Returns false if `algo` is some other KDF. */
+static bool hkdf_mac_name(const char *algo, char *mac_name, size_t size) {
+    size_t len = strlen(algo);
+    if (len < 7 || strncmp(algo, "HKDF(", 5) != 0 || algo[len - 1] != ')') {
+        return false;
+    }
+
+    const char *prf = algo + 5;
+    int prf_len = (int)(len - 6);
+    int n;
+    if (strncmp(prf, "HMAC(", 5) == 0) {
+        n = snprintf(mac_name, size, "%.*s", prf_len, prf);
+    } else {
+        n = snprintf(mac_name, size, "HMAC(%.*s)", prf_len, prf);
+    }
+    return n > 0 && (size_t)n < size;
+}
+
+/* HKDF-Extract of `secret` and `salt`; leaves `mac` keyed with the PRK. */
+static int hkdf_extract(botan_mac_t mac, size_t mac_len,
+                        JanetByteView secret, JanetByteView salt) {
+    uint8_t *prk = janet_smalloc(mac_len);
+    int ret = botan_mac_set_key(mac, salt.bytes, salt.len);
+    if (ret == 0) {
+        ret = botan_mac_update(mac, secret.bytes, secret.len);
+    }
+    if (ret == 0) {
+        ret = botan_mac_final(mac, prk);
+    }
+    if (ret == 0) {
+        ret = botan_mac_set_key(mac, prk, mac_len);
+    }
+    botan_scrub_mem(prk, mac_len);
+    janet_sfree(prk);
+    return ret;
+}
+
+/* HKDF-Expand of the PRK `mac` is keyed with into `out_len` bytes. */
+static int hkdf_expand(botan_mac_t mac, size_t mac_len,
+                       const uint8_t *info, size_t info_len,
+                       uint8_t *out, size_t out_len) {
+    if (out_len > 255 * mac_len) {
+        return BOTAN_FFI_ERROR_BAD_PARAMETER;
+    }
+
+    uint8_t *block = janet_smalloc(mac_len);
+    size_t block_len = 0;
+    uint8_t counter = 1;
+    int ret = 0;
+
+    for (size_t done = 0; done < out_len && ret == 0; counter++) {
+        ret = botan_mac_update(mac, block, block_len);
+        if (ret == 0) {
+            ret = botan_mac_update(mac, info, info_len);
+        }
+        if (ret == 0) {
+            ret = botan_mac_update(mac, &counter, 1);
+        }
+        if (ret == 0) {
+            ret = botan_mac_final(mac, block);
+        }
+        if (ret == 0) {
+            size_t n = out_len - done < mac_len ? out_len - done : mac_len;
+            memcpy(out + done, block, n);
+            done += n;
+            block_len = mac_len;
+        }
+    }
+
+    botan_scrub_mem(block, mac_len);
+    janet_sfree(block);
+    return ret;
+}
+
+/* Derives one key per label into consecutive slices of `out`. HKDF is
+ * extracted once; other KDFs are run once per label. */
+static int kdf_derive_many(const char *algo,
+                           JanetByteView secret, JanetByteView salt,
+                           const JanetByteView *labels, const size_t *lengths,
+                           int32_t count, uint8_t *out) {
+    char mac_name[HKDF_MAC_NAME_LEN];
+    int ret = 0;
+
+    if (!hkdf_mac_name(algo, mac_name, sizeof(mac_name))) {
+        for (int32_t i = 0; i < count && ret == 0; i++) {
+            ret = botan_kdf(algo, out, lengths[i],
+                            secret.bytes, secret.len,
+                            salt.bytes, salt.len,
+                            labels[i].bytes, labels[i].len);
+            out += lengths[i];
+        }
+        return ret;
+    }
+
+    botan_mac_t mac;
+    size_t mac_len;
+    ret = botan_mac_init(&mac, mac_name, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = botan_mac_output_length(mac, &mac_len);
+    if (ret == 0) {
+        ret = hkdf_extract(mac, mac_len, secret, salt);
+    }
+    for (int32_t i = 0; i < count && ret == 0; i++) {
+        ret = hkdf_expand(mac, mac_len, labels[i].bytes, labels[i].len,
+                          out, lengths[i]);
+        out += lengths[i];
+    }
+    botan_mac_destroy(mac);
+    return ret;
+}
+
+static JanetByteView kdf_label_view(Janet x) {
+    JanetByteView view;
+    if (!janet_bytes_view(x, &view.bytes, &view.len)) {
+        janet_panicf("expected bytes for label, got %v", x);
+    }
+    return view;
+}
+
+static size_t kdf_length_value(Janet x) {
+    if (!janet_checksize(x)) {
+        janet_panicf("expected size for length, got %v", x);
+    }
+    return (size_t)janet_unwrap_number(x);
+}
+
 static Janet cfun_kdf(int32_t argc, Janet *argv) {
-    janet_arity(argc, 4, 5);
+    janet_arity(argc, 4, 6);
     const char *algo = janet_getcstring(argv, 0);
     size_t out_len = janet_getsize(argv, 1);
     JanetByteView secret = janet_getbytes(argv, 2);
     JanetByteView salt = janet_getbytes(argv, 3);
-    JanetBuffer *out = janet_buffer(out_len);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
     JanetByteView label;
     label.bytes = NULL;
     label.len = 0;
 
-    if (argc == 5) {
+    if (argc >= 5 && !janet_checktype(argv[4], JANET_NIL)) {
         label = janet_getbytes(argv, 4);
     }
 
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        int ret = botan_kdf(algo, out, out_len,
+                            secret.bytes, secret.len,
+                            salt.bytes, salt.len,
+                            label.bytes, label.len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
+    JanetBuffer *out = janet_buffer(out_len);
     int ret = botan_kdf(algo, out->data, out_len,
                         secret.bytes, secret.len,
                         salt.bytes, salt.len,
@@ -32,12 +185,373 @@ static Janet cfun_kdf(int32_t argc, Janet *argv) {
     return janet_wrap_string(janet_string(out->data, out->count));
 }
 
+static Janet kdf_expand_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 5, 6);
+    const char *algo = janet_getcstring(argv, 0);
+    JanetByteView secret = janet_getbytes(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+    bool named = janet_checktypes(argv[3], JANET_TFLAG_DICTIONARY);
+    bool same_length = janet_checktype(argv[4], JANET_NUMBER);
+    size_t length = same_length ? janet_getsize(argv, 4) : 0;
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+    int32_t count;
+    JanetByteView *labels;
+    size_t *lengths;
+    Janet *names = NULL;
+
+    if (named) {
+        if (secure_out) {
+            janet_panic("out can only be given when labels is indexed");
+        }
+
+        JanetDictView dict = janet_getdictionary(argv, 3);
+        if (!same_length) {
+            janet_getdictionary(argv, 4);
+        }
+
+        count = dict.len;
+        labels = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+        lengths = janet_smalloc(sizeof(size_t) * (count + 1));
+        names = janet_smalloc(sizeof(Janet) * (count + 1));
+
+        int32_t i = 0;
+        const JanetKV *kv = NULL;
+        while ((kv = janet_dictionary_next(dict.kvs, dict.cap, kv))) {
+            names[i] = kv->key;
+            labels[i] = kdf_label_view(kv->value);
+            if (same_length) {
+                lengths[i] = length;
+            } else {
+                Janet len = janet_get(argv[4], kv->key);
+                if (janet_checktype(len, JANET_NIL)) {
+                    janet_panicf("no length given for label %v", kv->key);
+                }
+                lengths[i] = kdf_length_value(len);
+            }
+            i++;
+        }
+    } else {
+        JanetView view = janet_getindexed(argv, 3);
+        JanetView length_view = {NULL, 0};
+        if (!same_length) {
+            length_view = janet_getindexed(argv, 4);
+            if (length_view.len != view.len) {
+                janet_panicf("expected %d lengths, got %d", view.len, length_view.len);
+            }
+        }
+
+        count = view.len;
+        labels = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+        lengths = janet_smalloc(sizeof(size_t) * (count + 1));
+        for (int32_t i = 0; i < count; i++) {
+            labels[i] = kdf_label_view(view.items[i]);
+            lengths[i] = same_length ? length : kdf_length_value(length_view.items[i]);
+        }
+    }
+
+    size_t total = 0;
+    for (int32_t i = 0; i < count; i++) {
+        if (lengths[i] > INT32_MAX - total) {
+            janet_panic("Total output length is too large");
+        }
+        total += lengths[i];
+    }
+
+    Janet result;
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, total);
+        int ret = kdf_derive_many(algo, secret, salt, labels, lengths, count, out);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, total);
+        result = janet_wrap_abstract(secure_out);
+    } else if (!named) {
+        uint8_t *out = janet_string_begin((int32_t)total);
+        int ret = kdf_derive_many(algo, secret, salt, labels, lengths, count, out);
+        JANET_BOTAN_ASSERT(ret);
+
+        result = janet_wrap_string(janet_string_end(out));
+    } else {
+        uint8_t *out = janet_smalloc(total + 1);
+        int ret = kdf_derive_many(algo, secret, salt, labels, lengths, count, out);
+        if (ret != 0) {
+            botan_scrub_mem(out, total);
+            janet_sfree(out);
+            janet_panic(getBotanError(ret));
+        }
+
+        JanetKV *st = janet_struct_begin(count);
+        const uint8_t *key = out;
+        for (int32_t i = 0; i < count; i++) {
+            janet_struct_put(st, names[i], janet_wrap_string(janet_string(key, (int32_t)lengths[i])));
+            key += lengths[i];
+        }
+        botan_scrub_mem(out, total);
+        janet_sfree(out);
+        janet_sfree(names);
+        result = janet_wrap_struct(janet_struct_end(st));
+    }
+
+    janet_sfree(labels);
+    janet_sfree(lengths);
+    return result;
+}
+
+/*
+ * KDF object
+ *
+ * Binds a KDF to one secret and salt so that repeated derivations skip
+ * the name lookup. For HKDF the PRK is extracted up front and kept as the
+ * key of an HMAC object; other KDFs keep a copy of the secret in secure
+ * memory and run botan_kdf per derivation.
+ */
+
+typedef struct botan_kdf_obj {
+    char *algo;
+    botan_mac_t mac;
+    size_t mac_len;
+    uint8_t *secret;
+    size_t secret_len;
+    size_t secret_capacity;
+    uint8_t *salt;
+    size_t salt_len;
+    size_t salt_capacity;
+} botan_kdf_obj_t;
+
+/* Abstract Object functions */
+static int kdf_gc_fn(void *data, size_t len);
+static int kdf_get_fn(void *data, Janet key, Janet *out);
+static void kdf_tostring_fn(void *p, JanetBuffer *buffer);
+
+/* Janet functions */
+static Janet kdf_new(int32_t argc, Janet *argv);
+static Janet kdf_name(int32_t argc, Janet *argv);
+static Janet kdf_derive(int32_t argc, Janet *argv);
+static Janet kdf_derive_into(int32_t argc, Janet *argv);
+
+static JanetAbstractType kdf_obj_type = {
+    "botan/kdf",
+    kdf_gc_fn,
+    NULL,
+    kdf_get_fn,
+    NULL,   // put
+    NULL,   // marshal
+    NULL,   // unmarshal
+    kdf_tostring_fn,
+    JANET_ATEND_TOSTRING
+};
+
+static JanetMethod kdf_methods[] = {
+    {"name", kdf_name},
+    {"derive", kdf_derive},
+    {"derive-into", kdf_derive_into},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_kdf_obj_type() {
+    return &kdf_obj_type;
+}
+
+/* Abstract Object functions */
+static int kdf_gc_fn(void *data, size_t len) {
+    botan_kdf_obj_t *obj = (botan_kdf_obj_t *)data;
+
+    if (obj->secret) {
+        secure_arena_free(obj->secret, obj->secret_capacity);
+    }
+    if (obj->salt) {
+        secure_arena_free(obj->salt, obj->salt_capacity);
+    }
+    janet_free(obj->algo);
+    if (obj->mac) {
+        int ret = botan_mac_destroy(obj->mac);
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return 0;
+}
+
+static int kdf_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), kdf_methods, out);
+}
+
+static void kdf_tostring_fn(void *p, JanetBuffer *buffer) {
+    botan_kdf_obj_t *obj = (botan_kdf_obj_t *)p;
+    janet_buffer_push_cstring(buffer, obj->algo ? obj->algo : "");
+}
+
+/* KDF object helpers */
+static int kdf_obj_derive(botan_kdf_obj_t *obj, JanetByteView label,
+                          uint8_t *out, size_t out_len) {
+    if (obj->mac) {
+        return hkdf_expand(obj->mac, obj->mac_len, label.bytes, label.len,
+                           out, out_len);
+    }
+    return botan_kdf(obj->algo, out, out_len,
+                     obj->secret, obj->secret_len,
+                     obj->salt, obj->salt_len,
+                     label.bytes, label.len);
+}
+
+static JanetByteView kdf_opt_label(const Janet *argv, int32_t argc, int32_t n) {
+    JanetByteView label;
+    label.bytes = NULL;
+    label.len = 0;
+
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        label = janet_getbytes(argv, n);
+    }
+    return label;
+}
+
+/* Janet functions */
+static Janet kdf_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+    const char *algo = janet_getcstring(argv, 0);
+    JanetByteView secret = janet_getbytes(argv, 1);
+    JanetByteView salt = {NULL, 0};
+    char mac_name[HKDF_MAC_NAME_LEN];
+
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        salt = janet_getbytes(argv, 2);
+    }
+
+    botan_kdf_obj_t *obj = janet_abstract(&kdf_obj_type, sizeof(botan_kdf_obj_t));
+    memset(obj, 0, sizeof(botan_kdf_obj_t));
+
+    size_t algo_len = strlen(algo);
+    obj->algo = janet_malloc(algo_len + 1);
+    if (obj->algo == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(obj->algo, algo, algo_len + 1);
+
+    if (hkdf_mac_name(algo, mac_name, sizeof(mac_name))) {
+        int ret = botan_mac_init(&obj->mac, mac_name, 0);
+        JANET_BOTAN_ASSERT(ret);
+
+        ret = botan_mac_output_length(obj->mac, &obj->mac_len);
+        JANET_BOTAN_ASSERT(ret);
+
+        ret = hkdf_extract(obj->mac, obj->mac_len, secret, salt);
+        JANET_BOTAN_ASSERT(ret);
+
+        return janet_wrap_abstract(obj);
+    }
+
+    /* Fail early on an unknown algorithm rather than on first use. */
+    uint8_t probe[1];
+    int ret = botan_kdf(algo, probe, sizeof(probe),
+                        secret.bytes, secret.len,
+                        salt.bytes, salt.len,
+                        NULL, 0);
+    botan_scrub_mem(probe, sizeof(probe));
+    JANET_BOTAN_ASSERT(ret);
+
+    obj->secret = secure_arena_dup(secret, &obj->secret_capacity);
+    obj->secret_len = secret.len;
+    obj->salt = secure_arena_dup(salt, &obj->salt_capacity);
+    obj->salt_len = salt.len;
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet kdf_name(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+    botan_kdf_obj_t *obj = janet_getabstract(argv, 0, get_kdf_obj_type());
+
+    return janet_cstringv(obj->algo);
+}
+
+static Janet kdf_derive(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 4);
+    botan_kdf_obj_t *obj = janet_getabstract(argv, 0, get_kdf_obj_type());
+    size_t out_len = janet_getsize(argv, 1);
+    JanetByteView label = kdf_opt_label(argv, argc, 2);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 3);
+
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        int ret = kdf_obj_derive(obj, label, out, out_len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
+    if (out_len > INT32_MAX) {
+        janet_panic("Output too large");
+    }
+
+    uint8_t *out = janet_string_begin((int32_t)out_len);
+    int ret = kdf_obj_derive(obj, label, out, out_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    return janet_wrap_string(janet_string_end(out));
+}
+
+static Janet kdf_derive_into(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+    botan_kdf_obj_t *obj = janet_getabstract(argv, 0, get_kdf_obj_type());
+    JanetBuffer *buf = janet_getbuffer(argv, 1);
+    size_t out_len = janet_getsize(argv, 2);
+    JanetByteView label = kdf_opt_label(argv, argc, 3);
+
+    uint8_t *out = buffer_reserve_out(buf, out_len, &label);
+    int ret = kdf_obj_derive(obj, label, out, out_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    buf->count += (int32_t)out_len;
+    return janet_wrap_buffer(buf);
+}
+
 static JanetReg kdf_cfuns[] = {
     {"kdf", cfun_kdf,
-     "(kdf algo out-len secret salt &opt label)\n\n"
+     "(kdf algo out-len secret salt &opt label out)\n\n"
      "Performs a key derviation function (such as “HKDF(SHA-384)”) over the "
      "provided secret, salt and label values. Returns a value of the "
-     "specified length."
+     "specified length. If the secure buffer `out` is given, the value is "
+     "written into it and `out` is returned instead."
+    },
+    {"kdf/expand-many", kdf_expand_many,
+     "(kdf/expand-many algo secret salt labels lengths &opt out)\n\n"
+     "Derive one key per label from the same `secret` and `salt`. For "
+     "HKDF the pseudorandom key is extracted once and only the expand "
+     "step runs per label; other KDFs run once per label. `lengths` is "
+     "either one output length used for every key or a length per label. "
+     "If `labels` is indexed, `lengths` must be indexed in the same order "
+     "and the keys are returned concatenated in one string, or written "
+     "into the secure buffer `out`. If `labels` is a struct or table of "
+     "name to label, `lengths` may likewise map names to lengths and a "
+     "struct of name to key is returned."
+    },
+    {"kdf/new", kdf_new,
+     "(kdf/new algo secret &opt salt)\n\n"
+     "Create a KDF object for `algo` bound to `secret` and `salt`, so that "
+     "many keys can be derived without looking up the algorithm again. "
+     "For HKDF the pseudorandom key is extracted here once. Returns "
+     "kdf-obj."
+    },
+    {"kdf/name", kdf_name,
+     "(kdf/name kdf-obj)\n\n"
+     "Return the algorithm name of `kdf-obj`."
+    },
+    {"kdf/derive", kdf_derive,
+     "(kdf/derive kdf-obj out-len &opt label out)\n\n"
+     "Derive `out-len` bytes for `label` from the secret and salt bound to "
+     "`kdf-obj`. The result equals `(kdf algo out-len secret salt label)`. "
+     "If the secure buffer `out` is given, the key is written into it and "
+     "`out` is returned instead."
+    },
+    {"kdf/derive-into", kdf_derive_into,
+     "(kdf/derive-into kdf-obj buf out-len &opt label)\n\n"
+     "Like `kdf/derive`, but appends the key to the buffer `buf`. Returns "
+     "`buf`."
     },
     {NULL, NULL, NULL}
 };
@@ -0,0 +1,522 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_KEYSTORE_H
+#define BOTAN_KEYSTORE_H
+
+#include <math.h>
+
+/*
+ * Keystore
+ *
+ * A least recently used cache of private keys indexed by key id, for
+ * services that hold many keys but only use some of them at a time. A
+ * key stays parsed while it is in the store, and so do its signature
+ * operators (the per-key cache of pk-sign/sign) and one decryption
+ * operator per entry, so neither parsing nor operator setup happens on
+ * the request path. The store is bounded by a number of entries and by an
+ * estimate of their memory, the encoded size of each key. An optional
+ * function is called with the id and the key of every evicted entry.
+ */
+
+typedef struct keystore_entry {
+    Janet id;
+    Janet key;
+    size_t bytes;
+    int32_t prev;
+    int32_t next;
+    botan_pk_op_decrypt_t decrypt_op;
+    char decrypt_padding[PK_OP_CACHE_PADDING_LEN];
+} keystore_entry_t;
+
+typedef struct botan_keystore_obj {
+    JanetTable *index;
+    keystore_entry_t *entries;
+    int32_t capacity;
+    int32_t head;
+    int32_t tail;
+    int32_t free_list;
+    size_t count;
+    size_t bytes;
+    size_t max_entries;
+    size_t max_bytes;
+    Janet on_evict;
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+} botan_keystore_obj_t;
+
+/* Abstract Object functions */
+static int keystore_gc_fn(void *data, size_t len);
+static int keystore_gcmark_fn(void *data, size_t len);
+static int keystore_get_fn(void *data, Janet key, Janet *out);
+
+/* Janet functions */
+static Janet keystore_new(int32_t argc, Janet *argv);
+static Janet keystore_load(int32_t argc, Janet *argv);
+static Janet keystore_put(int32_t argc, Janet *argv);
+static Janet keystore_get(int32_t argc, Janet *argv);
+static Janet keystore_remove(int32_t argc, Janet *argv);
+static Janet keystore_sign(int32_t argc, Janet *argv);
+static Janet keystore_decrypt(int32_t argc, Janet *argv);
+static Janet keystore_stats(int32_t argc, Janet *argv);
+static Janet keystore_clear(int32_t argc, Janet *argv);
+
+static JanetAbstractType keystore_obj_type = {
+    "botan/keystore",
+    keystore_gc_fn,
+    keystore_gcmark_fn,
+    keystore_get_fn,
+    JANET_ATEND_GET
+};
+
+static JanetMethod keystore_methods[] = {
+    {"load", keystore_load},
+    {"put", keystore_put},
+    {"get", keystore_get},
+    {"remove", keystore_remove},
+    {"sign", keystore_sign},
+    {"decrypt", keystore_decrypt},
+    {"stats", keystore_stats},
+    {"clear", keystore_clear},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_keystore_obj_type() {
+    return &keystore_obj_type;
+}
+
+/* Abstract Object functions */
+static int keystore_gc_fn(void *data, size_t len) {
+    botan_keystore_obj_t *obj = (botan_keystore_obj_t *)data;
+
+    for (int32_t i = obj->head; i >= 0; i = obj->entries[i].next) {
+        botan_pk_op_decrypt_destroy(obj->entries[i].decrypt_op);
+    }
+    janet_free(obj->entries);
+
+    return 0;
+}
+
+static int keystore_gcmark_fn(void *data, size_t len) {
+    botan_keystore_obj_t *obj = (botan_keystore_obj_t *)data;
+
+    if (obj->index) {
+        janet_mark(janet_wrap_table(obj->index));
+    }
+    for (int32_t i = obj->head; i >= 0; i = obj->entries[i].next) {
+        janet_mark(obj->entries[i].id);
+        janet_mark(obj->entries[i].key);
+    }
+    janet_mark(obj->on_evict);
+
+    return 0;
+}
+
+static int keystore_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), keystore_methods, out);
+}
+
+/* Helpers */
+
+static int32_t keystore_find(botan_keystore_obj_t *obj, Janet id) {
+    Janet slot = janet_table_get(obj->index, id);
+    return janet_checktype(slot, JANET_NUMBER) ? (int32_t)janet_unwrap_number(slot) : -1;
+}
+
+static void keystore_unlink(botan_keystore_obj_t *obj, int32_t i) {
+    keystore_entry_t *e = &obj->entries[i];
+    if (e->prev >= 0) {
+        obj->entries[e->prev].next = e->next;
+    } else {
+        obj->head = e->next;
+    }
+    if (e->next >= 0) {
+        obj->entries[e->next].prev = e->prev;
+    } else {
+        obj->tail = e->prev;
+    }
+}
+
+static void keystore_push_front(botan_keystore_obj_t *obj, int32_t i) {
+    keystore_entry_t *e = &obj->entries[i];
+    e->prev = -1;
+    e->next = obj->head;
+    if (obj->head >= 0) {
+        obj->entries[obj->head].prev = i;
+    } else {
+        obj->tail = i;
+    }
+    obj->head = i;
+}
+
+/* Looks `id` up, counting a hit or a miss, and marks the entry as most
+ * recently used. Returns -1 if it is not in the store. */
+static int32_t keystore_touch(botan_keystore_obj_t *obj, Janet id) {
+    int32_t i = keystore_find(obj, id);
+    if (i < 0) {
+        obj->misses++;
+        return -1;
+    }
+
+    obj->hits++;
+    if (obj->head != i) {
+        keystore_unlink(obj, i);
+        keystore_push_front(obj, i);
+    }
+    return i;
+}
+
+static int32_t keystore_touch_or_panic(botan_keystore_obj_t *obj, Janet id) {
+    int32_t i = keystore_touch(obj, id);
+    if (i < 0) {
+        janet_panicf("no key %v in keystore", id);
+    }
+    return i;
+}
+
+/* Takes entry `i` out of the store. Returns its key; the id is left in
+ * `*id`. */
+static Janet keystore_detach(botan_keystore_obj_t *obj, int32_t i, Janet *id) {
+    keystore_entry_t *e = &obj->entries[i];
+    Janet key = e->key;
+    *id = e->id;
+
+    keystore_unlink(obj, i);
+    janet_table_remove(obj->index, e->id);
+    botan_pk_op_decrypt_destroy(e->decrypt_op);
+    obj->count--;
+    obj->bytes -= e->bytes;
+
+    memset(e, 0, sizeof(keystore_entry_t));
+    e->id = janet_wrap_nil();
+    e->key = janet_wrap_nil();
+    e->next = obj->free_list;
+    obj->free_list = i;
+    return key;
+}
+
+/* Evicts least recently used entries, but never the most recent one, until
+ * the store is within its limits. The store is consistent whenever the
+ * eviction function runs, so it may use the store itself. */
+static void keystore_trim(botan_keystore_obj_t *obj) {
+    while (obj->count > 1 &&
+           ((obj->max_entries && obj->count > obj->max_entries) ||
+            (obj->max_bytes && obj->bytes > obj->max_bytes))) {
+        Janet id;
+        Janet key = keystore_detach(obj, obj->tail, &id);
+        obj->evictions++;
+
+        if (janet_checktype(obj->on_evict, JANET_FUNCTION)) {
+            Janet args[2] = {id, key};
+            janet_call(janet_unwrap_function(obj->on_evict), 2, args);
+        }
+    }
+}
+
+static int32_t keystore_alloc_slot(botan_keystore_obj_t *obj) {
+    if (obj->free_list < 0) {
+        int32_t capacity = obj->capacity ? obj->capacity * 2 : 16;
+        keystore_entry_t *entries = janet_realloc(obj->entries, sizeof(keystore_entry_t) * capacity);
+        if (entries == NULL) {
+            JANET_OUT_OF_MEMORY;
+        }
+        for (int32_t i = capacity - 1; i >= obj->capacity; i--) {
+            memset(&entries[i], 0, sizeof(keystore_entry_t));
+            entries[i].id = janet_wrap_nil();
+            entries[i].key = janet_wrap_nil();
+            entries[i].next = obj->free_list;
+            obj->free_list = i;
+        }
+        obj->entries = entries;
+        obj->capacity = capacity;
+    }
+
+    int32_t i = obj->free_list;
+    obj->free_list = obj->entries[i].next;
+    return i;
+}
+
+/* Adds `key` under `id`, replacing any previous entry of that id. */
+static void keystore_insert(botan_keystore_obj_t *obj, Janet id, Janet key, size_t bytes) {
+    int32_t old = keystore_find(obj, id);
+    if (old >= 0) {
+        Janet old_id;
+        keystore_detach(obj, old, &old_id);
+    }
+
+    int32_t i = keystore_alloc_slot(obj);
+    keystore_entry_t *e = &obj->entries[i];
+    e->id = id;
+    e->key = key;
+    e->bytes = bytes + sizeof(keystore_entry_t);
+    e->decrypt_op = NULL;
+    e->decrypt_padding[0] = 0;
+    keystore_push_front(obj, i);
+    janet_table_put(obj->index, id, janet_wrap_number(i));
+    obj->count++;
+    obj->bytes += e->bytes;
+
+    keystore_trim(obj);
+}
+
+static int keystore_count_func(botan_view_ctx view_ctx, const uint8_t *bin, size_t len) {
+    (void)bin;
+    *(size_t *)view_ctx = len;
+    return 0;
+}
+
+/* The size of a key, estimated from its DER encoding whichever way it
+ * was loaded. */
+static size_t keystore_key_bytes(Janet key) {
+    botan_private_key_obj_t *obj = janet_unwrap_abstract(key);
+    size_t bytes = 0;
+    int ret = botan_privkey_view_der(obj->private_key, &bytes, (botan_view_bin_fn)keystore_count_func);
+    JANET_BOTAN_ASSERT(ret);
+    return bytes;
+}
+
+/* Table keys cannot be nil or NaN, so neither can ids. */
+static Janet keystore_getid(const Janet *argv, int32_t n) {
+    Janet id = argv[n];
+    if (janet_checktype(id, JANET_NIL) ||
+        (janet_checktype(id, JANET_NUMBER) && isnan(janet_unwrap_number(id)))) {
+        janet_panicf("bad slot #%d, expected a keystore id, got %v", n, id);
+    }
+    return id;
+}
+
+static Janet keystore_stats_struct(botan_keystore_obj_t *obj) {
+    JanetKV *st = janet_struct_begin(7);
+    janet_struct_put(st, janet_ckeywordv("entries"), janet_wrap_number((double)obj->count));
+    janet_struct_put(st, janet_ckeywordv("bytes"), janet_wrap_number((double)obj->bytes));
+    janet_struct_put(st, janet_ckeywordv("max-entries"), janet_wrap_number((double)obj->max_entries));
+    janet_struct_put(st, janet_ckeywordv("max-bytes"), janet_wrap_number((double)obj->max_bytes));
+    janet_struct_put(st, janet_ckeywordv("hits"), janet_wrap_number((double)obj->hits));
+    janet_struct_put(st, janet_ckeywordv("misses"), janet_wrap_number((double)obj->misses));
+    janet_struct_put(st, janet_ckeywordv("evictions"), janet_wrap_number((double)obj->evictions));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+/* Janet functions */
+static Janet keystore_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 0, 3);
+
+    size_t max_entries = janet_optsize(argv, argc, 0, 0);
+    size_t max_bytes = janet_optsize(argv, argc, 1, 0);
+    Janet on_evict = janet_wrap_nil();
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        on_evict = janet_wrap_function(janet_getfunction(argv, 2));
+    }
+
+    botan_keystore_obj_t *obj = janet_abstract(&keystore_obj_type, sizeof(botan_keystore_obj_t));
+    memset(obj, 0, sizeof(botan_keystore_obj_t));
+    obj->head = -1;
+    obj->tail = -1;
+    obj->free_list = -1;
+    obj->max_entries = max_entries;
+    obj->max_bytes = max_bytes;
+    obj->on_evict = on_evict;
+    obj->index = janet_table(0);
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet keystore_load(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    Janet id = keystore_getid(argv, 1);
+
+    Janet key = private_key_load(argc - 2, argv + 2);
+    keystore_insert(obj, id, key, keystore_key_bytes(key));
+
+    return key;
+}
+
+static Janet keystore_put(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 3);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    Janet id = keystore_getid(argv, 1);
+    janet_getabstract(argv, 2, get_private_key_obj_type());
+
+    keystore_insert(obj, id, argv[2], keystore_key_bytes(argv[2]));
+    return argv[2];
+}
+
+static Janet keystore_get(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    int32_t i = keystore_touch(obj, keystore_getid(argv, 1));
+
+    return i < 0 ? janet_wrap_nil() : obj->entries[i].key;
+}
+
+static Janet keystore_remove(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    int32_t i = keystore_find(obj, keystore_getid(argv, 1));
+    if (i < 0) {
+        return janet_wrap_nil();
+    }
+
+    Janet id;
+    return keystore_detach(obj, i, &id);
+}
+
+static Janet keystore_sign(int32_t argc, Janet *argv) {
+    janet_arity(argc, 4, 5);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    int32_t i = keystore_touch_or_panic(obj, keystore_getid(argv, 1));
+
+    /* pk-sign/sign keeps the operators on the key object. */
+    Janet args[4] = {obj->entries[i].key, argv[2], argv[3], janet_wrap_nil()};
+    if (argc > 4) {
+        args[3] = argv[4];
+    }
+    return pk_sign_sign(argc - 1, args);
+}
+
+static Janet keystore_decrypt(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 4);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    const char *padding = janet_getcstring(argv, 2);
+    JanetByteView ciphertext = janet_getbytes(argv, 3);
+    int32_t i = keystore_touch_or_panic(obj, keystore_getid(argv, 1));
+    keystore_entry_t *e = &obj->entries[i];
+
+    int ret;
+    size_t padding_len = strlen(padding);
+    botan_pk_op_decrypt_t op = e->decrypt_op;
+    bool owned = padding_len >= PK_OP_CACHE_PADDING_LEN;
+    if (owned || op == NULL || strcmp(e->decrypt_padding, padding) != 0) {
+        botan_private_key_obj_t *key = janet_unwrap_abstract(e->key);
+        ret = botan_pk_op_decrypt_create(&op, key->private_key, padding, 0);
+        JANET_BOTAN_ASSERT(ret);
+
+        if (!owned) {
+            botan_pk_op_decrypt_destroy(e->decrypt_op);
+            e->decrypt_op = op;
+            memcpy(e->decrypt_padding, padding, padding_len + 1);
+        }
+    }
+
+    size_t out_len = 0;
+    uint8_t *out = NULL;
+    ret = botan_pk_op_decrypt_output_length(op, ciphertext.len, &out_len);
+    if (ret == 0) {
+        out = janet_smalloc(out_len + 1);
+        ret = botan_pk_op_decrypt(op, out, &out_len, ciphertext.bytes, ciphertext.len);
+    }
+    if (owned) {
+        botan_pk_op_decrypt_destroy(op);
+    }
+    if (ret != 0) {
+        if (out) {
+            janet_sfree(out);
+        }
+        janet_panic(getBotanError(ret));
+    }
+
+    Janet plaintext = janet_wrap_string(janet_string(out, out_len));
+    botan_scrub_mem(out, out_len);
+    janet_sfree(out);
+    return plaintext;
+}
+
+static Janet keystore_stats(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    return keystore_stats_struct(obj);
+}
+
+static Janet keystore_clear(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+
+    botan_keystore_obj_t *obj = janet_getabstract(argv, 0, get_keystore_obj_type());
+    while (obj->head >= 0) {
+        Janet id;
+        keystore_detach(obj, obj->head, &id);
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+static JanetReg keystore_cfuns[] = {
+    {"keystore/new", keystore_new,
+     "(keystore/new &opt max-entries max-bytes on-evict)\n\n"
+     "Create a store of private keys indexed by key id, which can be any "
+     "value except nil and NaN. When it holds more than `max-entries` "
+     "keys, or their estimated size exceeds `max-bytes`, the least "
+     "recently used keys are evicted; 0 or nil means no limit. The size of "
+     "a key is estimated from its DER encoding. If `on-evict` "
+     "is given, it is called with the id and the key of every entry "
+     "evicted to stay within the limits. Returns `keystore-obj`."
+    },
+    {"keystore/load", keystore_load,
+     "(keystore/load keystore-obj id blob &opt password)\n\n"
+     "Load a private key from `blob` as `privkey/load` does and add it "
+     "under `id`, replacing any key stored under that id. Returns the key."
+    },
+    {"keystore/put", keystore_put,
+     "(keystore/put keystore-obj id privkey)\n\n"
+     "Add `privkey` under `id`, replacing any key stored under that id. "
+     "Returns `privkey`."
+    },
+    {"keystore/get", keystore_get,
+     "(keystore/get keystore-obj id)\n\n"
+     "Returns the key stored under `id`, or nil. Counts as a hit or a miss "
+     "and makes the key the most recently used."
+    },
+    {"keystore/remove", keystore_remove,
+     "(keystore/remove keystore-obj id)\n\n"
+     "Remove the key stored under `id` without calling `on-evict`. Returns "
+     "the key, or nil if there was none."
+    },
+    {"keystore/sign", keystore_sign,
+     "(keystore/sign keystore-obj id hash-and-padding message &opt rng)\n\n"
+     "Sign `message` with the key stored under `id`, reusing its signature "
+     "operators like `pk-sign/sign`. Raises an error if there is no such "
+     "key. Returns the signature."
+    },
+    {"keystore/decrypt", keystore_decrypt,
+     "(keystore/decrypt keystore-obj id padding ciphertext)\n\n"
+     "Decrypt `ciphertext` with the key stored under `id`. The decryption "
+     "operator for the last `padding` used is kept with the entry. Raises "
+     "an error if there is no such key. Returns the plaintext."
+    },
+    {"keystore/stats", keystore_stats,
+     "(keystore/stats keystore-obj)\n\n"
+     "Returns a struct of the `:entries` and estimated `:bytes` in use, the "
+     "`:max-entries` and `:max-bytes` limits, and the `:hits`, `:misses` "
+     "and `:evictions` counters."
+    },
+    {"keystore/clear", keystore_clear,
+     "(keystore/clear keystore-obj)\n\n"
+     "Remove every key without calling `on-evict`. The counters are kept. "
+     "Returns `keystore-obj`."
+    },
+
+    {NULL, NULL, NULL}
+};
+
+static void submod_keystore(JanetTable *env) {
+    janet_cfuns(env, "botan", keystore_cfuns);
+    janet_register_abstract_type(get_keystore_obj_type());
+}
+
+#endif /* BOTAN_KEYSTORE_H */
@@ -45,11 +45,12 @@ static Janet nist_key_wrap(int32_t argc, Janet *argv) {
 }
 
 static Janet nist_key_unwrap(int32_t argc, Janet *argv) {
-    janet_arity(argc, 2, 3);
+    janet_arity(argc, 2, 4);
     JanetByteView kek = janet_getbytes(argv, 0);
     JanetByteView wrapped_key = janet_getbytes(argv, 1);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 3);
     const char *cipher;
-    if (argc == 3) {
+    if (argc >= 3 && !janet_checktype(argv[2], JANET_NIL)) {
         cipher = janet_getcstring(argv, 2);
     } else {
         const char *ciphers[3] = { "AES-128", "AES-192", "AES-256" };
@@ -69,9 +70,22 @@ static Janet nist_key_unwrap(int32_t argc, Janet *argv) {
         }
     }
 
-    JanetBuffer *key = janet_buffer(wrapped_key.len);
     size_t key_len = wrapped_key.len;
 
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, key_len);
+        int ret = botan_nist_kw_dec(cipher, 0,
+                                    wrapped_key.bytes, wrapped_key.len,
+                                    kek.bytes, kek.len,
+                                    out, &key_len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, key_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
+    JanetBuffer *key = janet_buffer(wrapped_key.len);
+
     int ret = botan_nist_kw_dec(cipher, 0,
                                 wrapped_key.bytes, wrapped_key.len,
                                 kek.bytes, kek.len,
@@ -88,9 +102,10 @@ static JanetReg nist_key_wrap_cfuns[] = {
      "8 bytes long. If omitted, \"AES\" is used for `cipher`."
     },
     {"nist-key-unwrap", nist_key_unwrap,
-     "(nist-key-unwrap kek wrapped &opt cipher)\n\n"
+     "(nist-key-unwrap kek wrapped &opt cipher out)\n\n"
      "This unwraps the result of nist-key-wrap. If omitted, \"AES\" is "
-     "used for `cipher`."
+     "used for `cipher`. If the secure buffer `out` is given, the key is "
+     "written into it and `out` is returned."
     },
     {NULL, NULL, NULL}
 };
@@ -0,0 +1,633 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_PASSWORD_H
+#define BOTAN_PASSWORD_H
+
+/*
+ * Encoded password hashes
+ *
+ * Argon2, scrypt and PBKDF2 hashes use the PHC string format with unpadded
+ * standard base64 for the salt and the hash:
+ *
+ *   $argon2id$v=19$m=19456,t=2,p=1$<salt>$<hash>
+ *   $scrypt$ln=15,r=8,p=1$<salt>$<hash>
+ *   $pbkdf2-sha256$i=600000$<salt>$<hash>
+ *
+ * bcrypt keeps its own modular crypt format ($2a$12$...).
+ */
+
+#define PASSWORD_ARGON2ID       0
+#define PASSWORD_ARGON2I        1
+#define PASSWORD_ARGON2D        2
+#define PASSWORD_SCRYPT         3
+#define PASSWORD_PBKDF2_SHA256  4
+#define PASSWORD_PBKDF2_SHA512  5
+#define PASSWORD_BCRYPT         6
+
+#define PASSWORD_SALT_LEN       16
+#define PASSWORD_HASH_LEN       32
+#define PASSWORD_MAX_SALT_LEN   64
+#define PASSWORD_MAX_HASH_LEN   128
+
+/* Cost limits, so that an encoded hash from an untrusted source cannot
+ * make password/verify run for minutes or allocate gigabytes. Argon2 and
+ * scrypt are also bounded in total work, memory times passes or lanes. */
+#define PASSWORD_MAX_ARGON2_M     (1 << 21)  /* KiB */
+#define PASSWORD_MAX_ARGON2_WORK  (1 << 23)  /* m * t */
+#define PASSWORD_MAX_ARGON2_P     64
+#define PASSWORD_MAX_SCRYPT_LN    22
+#define PASSWORD_MAX_SCRYPT_WORK  (1 << 23)  /* p * r * N */
+#define PASSWORD_MAX_PBKDF2_I     10000000
+#define PASSWORD_MIN_BCRYPT_COST  4
+#define PASSWORD_MAX_BCRYPT_COST  18
+
+typedef struct password_algo {
+    const char *name;
+    const char *botan_name;
+} password_algo_t;
+
+static const password_algo_t password_algos[] = {
+    {"argon2id", "Argon2id"},
+    {"argon2i", "Argon2i"},
+    {"argon2d", "Argon2d"},
+    {"scrypt", "Scrypt"},
+    {"pbkdf2-sha256", "PBKDF2(SHA-256)"},
+    {"pbkdf2-sha512", "PBKDF2(SHA-512)"},
+    {"bcrypt", NULL},
+};
+
+#define PASSWORD_ALGOS ((int)(sizeof(password_algos) / sizeof(password_algos[0])))
+
+/* Cost parameters. Argon2: p1 = m (KiB), p2 = t, p3 = p. Scrypt: p1 = ln,
+ * p2 = r, p3 = p. PBKDF2: p1 = iterations. bcrypt: p1 = cost. */
+typedef struct password_params {
+    int algo;
+    size_t p1;
+    size_t p2;
+    size_t p3;
+} password_params_t;
+
+typedef struct password_hash {
+    password_params_t params;
+    uint8_t salt[PASSWORD_MAX_SALT_LEN];
+    size_t salt_len;
+    uint8_t hash[PASSWORD_MAX_HASH_LEN];
+    size_t hash_len;
+} password_hash_t;
+
+static bool password_is_argon2(int algo) {
+    return algo == PASSWORD_ARGON2ID || algo == PASSWORD_ARGON2I ||
+           algo == PASSWORD_ARGON2D;
+}
+
+static int password_find_algo(const uint8_t *name, size_t len) {
+    for (int i = 0; i < PASSWORD_ALGOS; i++) {
+        if (strlen(password_algos[i].name) == len &&
+            memcmp(password_algos[i].name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static size_t password_param(Janet params, const char *key, size_t dflt) {
+    if (janet_checktype(params, JANET_NIL)) {
+        return dflt;
+    }
+
+    Janet v = janet_get(params, janet_ckeywordv(key));
+    if (janet_checktype(v, JANET_NIL)) {
+        return dflt;
+    }
+    if (!janet_checksize(v) || janet_unwrap_number(v) < 1) {
+        janet_panicf("Expected positive integer for :%s, got %v", key, v);
+    }
+    return (size_t)janet_unwrap_number(v);
+}
+
+/* Whether the cost parameters are within the limits above. */
+static bool password_params_ok(const password_params_t *params) {
+    size_t p1 = params->p1, p2 = params->p2, p3 = params->p3;
+
+    switch (params->algo) {
+        case PASSWORD_SCRYPT:
+            return p1 >= 1 && p1 <= PASSWORD_MAX_SCRYPT_LN &&
+                   p2 >= 1 && p2 <= SCRYPT_MAX_R && p3 >= 1 && p3 <= SCRYPT_MAX_P &&
+                   (uint64_t)p3 * ((uint64_t)p2 << p1) <= PASSWORD_MAX_SCRYPT_WORK;
+        case PASSWORD_PBKDF2_SHA256:
+        case PASSWORD_PBKDF2_SHA512:
+            return p1 >= 1 && p1 <= PASSWORD_MAX_PBKDF2_I;
+        case PASSWORD_BCRYPT:
+            return p1 >= PASSWORD_MIN_BCRYPT_COST && p1 <= PASSWORD_MAX_BCRYPT_COST;
+        default:
+            return p3 >= 1 && p3 <= PASSWORD_MAX_ARGON2_P &&
+                   p1 >= 8 * p3 && p1 <= PASSWORD_MAX_ARGON2_M &&
+                   p2 >= 1 && (uint64_t)p1 * p2 <= PASSWORD_MAX_ARGON2_WORK;
+    }
+}
+
+/* Reads the target algorithm and cost parameters from `argv[n]` and
+ * `argv[n + 1]`, filling in the defaults for anything omitted. */
+static password_params_t password_get_params(const Janet *argv, int32_t argc, int32_t n) {
+    password_params_t params;
+    Janet dict = janet_wrap_nil();
+
+    params.algo = PASSWORD_ARGON2ID;
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        JanetKeyword name = janet_getkeyword(argv, n);
+        params.algo = password_find_algo(name, janet_string_length(name));
+        if (params.algo < 0) {
+            janet_panicf("Unknown password hash algorithm %v", argv[n]);
+        }
+    }
+    if (argc > n + 1 && !janet_checktype(argv[n + 1], JANET_NIL)) {
+        if (!janet_checktypes(argv[n + 1], JANET_TFLAG_DICTIONARY)) {
+            janet_panic_type(argv[n + 1], n + 1, JANET_TFLAG_DICTIONARY);
+        }
+        dict = argv[n + 1];
+    }
+
+    switch (params.algo) {
+        case PASSWORD_SCRYPT:
+            params.p1 = password_param(dict, "ln", 15);
+            params.p2 = password_param(dict, "r", 8);
+            params.p3 = password_param(dict, "p", 1);
+            break;
+        case PASSWORD_PBKDF2_SHA256:
+        case PASSWORD_PBKDF2_SHA512:
+            params.p1 = password_param(dict, "i", 600000);
+            params.p2 = 0;
+            params.p3 = 0;
+            break;
+        case PASSWORD_BCRYPT:
+            params.p1 = password_param(dict, "cost", 12);
+            params.p2 = 0;
+            params.p3 = 0;
+            break;
+        default:
+            params.p1 = password_param(dict, "m", 19456);
+            params.p2 = password_param(dict, "t", 2);
+            params.p3 = password_param(dict, "p", 1);
+            break;
+    }
+
+    if (!password_params_ok(&params)) {
+        janet_panicf("Cost parameters for %s are out of range",
+                     password_algos[params.algo].name);
+    }
+    return params;
+}
+
+/* Parses a decimal number of at most 10 digits from [*p, end). */
+static bool password_parse_number(const uint8_t **p, const uint8_t *end, size_t *out) {
+    const uint8_t *s = *p;
+    size_t v = 0;
+    int digits = 0;
+
+    while (s < end && *s >= '0' && *s <= '9' && digits < 10) {
+        v = v * 10 + (size_t)(*s - '0');
+        s++;
+        digits++;
+    }
+    if (digits == 0 || (s < end && *s >= '0' && *s <= '9')) {
+        return false;
+    }
+
+    *p = s;
+    *out = v;
+    return true;
+}
+
+/* Parses a comma separated "k=v" list such as "m=19456,t=2,p=1". Every
+ * key in `keys` must appear exactly once. */
+static bool password_parse_fields(const uint8_t *s, const uint8_t *end,
+                                  const char *keys[], size_t *values[], int count) {
+    int seen = 0;
+
+    while (s < end) {
+        const uint8_t *eq = memchr(s, '=', end - s);
+        if (eq == NULL) {
+            return false;
+        }
+
+        int k = 0;
+        while (k < count && !(strlen(keys[k]) == (size_t)(eq - s) &&
+                              memcmp(keys[k], s, eq - s) == 0)) {
+            k++;
+        }
+        if (k == count || (seen & (1 << k))) {
+            return false;
+        }
+        seen |= 1 << k;
+
+        s = eq + 1;
+        if (!password_parse_number(&s, end, values[k])) {
+            return false;
+        }
+        if (s < end && *s++ != ',') {
+            return false;
+        }
+    }
+
+    return seen == (1 << count) - 1;
+}
+
+static bool password_parse_b64(const uint8_t *s, const uint8_t *end,
+                               uint8_t *out, size_t max_len, size_t *out_len) {
+    size_t len = end - s;
+
+    if (len == 0 || ((len + 3) / 4) * 3 > max_len) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] == '=' || codec_is_space(s[i])) {
+            return false;
+        }
+    }
+    return codec_base64_decode(s, len, out, out_len, 0) == BOTAN_FFI_SUCCESS;
+}
+
+static bool password_parse_bcrypt(JanetByteView enc, password_hash_t *out) {
+    /* $2a$12$ followed by 53 characters of salt and hash. The output of
+     * `bcrypt` may still carry its NUL terminator. */
+    if (enc.len == 61 && enc.bytes[60] == 0) {
+        enc.len = 60;
+    }
+    if (enc.len != 60 || enc.bytes[0] != '$' || enc.bytes[1] != '2' ||
+        enc.bytes[3] != '$' || enc.bytes[6] != '$') {
+        return false;
+    }
+    if (enc.bytes[2] != 'a' && enc.bytes[2] != 'b' && enc.bytes[2] != 'y') {
+        return false;
+    }
+
+    const uint8_t *s = enc.bytes + 4;
+    if (!password_parse_number(&s, enc.bytes + 6, &out->params.p1) ||
+        s != enc.bytes + 6) {
+        return false;
+    }
+
+    out->params.algo = PASSWORD_BCRYPT;
+    return password_params_ok(&out->params);
+}
+
+/* Splits an encoded hash into its algorithm, parameters, salt and hash.
+ * Returns false if `enc` is not in a supported format. */
+static bool password_parse(JanetByteView enc, password_hash_t *out) {
+    const uint8_t *fields[6];
+    const uint8_t *end = enc.bytes + enc.len;
+    int count = 0;
+
+    memset(out, 0, sizeof(password_hash_t));
+
+    if (enc.len < 2 || enc.bytes[0] != '$') {
+        return false;
+    }
+    if (enc.bytes[1] == '2') {
+        return password_parse_bcrypt(enc, out);
+    }
+
+    for (const uint8_t *s = enc.bytes; s < end; s++) {
+        if (*s == '$') {
+            if (count == 6) {
+                return false;
+            }
+            fields[count++] = s + 1;
+        }
+    }
+
+    /* Field i spans [fields[i], fields[i + 1] - 1) */
+#define FIELD_END(i) ((i) + 1 < count ? fields[(i) + 1] - 1 : end)
+
+    int algo = password_find_algo(fields[0], FIELD_END(0) - fields[0]);
+    if (algo < 0 || algo == PASSWORD_BCRYPT) {
+        return false;
+    }
+    out->params.algo = algo;
+
+    int f = 1;
+    if (password_is_argon2(algo)) {
+        size_t version = 0;
+        if (count != 5 || FIELD_END(1) - fields[1] < 3 ||
+            memcmp(fields[1], "v=", 2) != 0) {
+            return false;
+        }
+        const uint8_t *s = fields[1] + 2;
+        if (!password_parse_number(&s, FIELD_END(1), &version) ||
+            s != FIELD_END(1) || version != 19) {
+            return false;
+        }
+
+        const char *keys[] = {"m", "t", "p"};
+        size_t *values[] = {&out->params.p1, &out->params.p2, &out->params.p3};
+        if (!password_parse_fields(fields[2], FIELD_END(2), keys, values, 3)) {
+            return false;
+        }
+        f = 3;
+    } else if (algo == PASSWORD_SCRYPT) {
+        const char *keys[] = {"ln", "r", "p"};
+        size_t *values[] = {&out->params.p1, &out->params.p2, &out->params.p3};
+        if (count != 4 ||
+            !password_parse_fields(fields[1], FIELD_END(1), keys, values, 3)) {
+            return false;
+        }
+        f = 2;
+    } else {
+        const char *keys[] = {"i"};
+        size_t *values[] = {&out->params.p1};
+        if (count != 4 ||
+            !password_parse_fields(fields[1], FIELD_END(1), keys, values, 1)) {
+            return false;
+        }
+        f = 2;
+    }
+
+    if (!password_parse_b64(fields[f], FIELD_END(f), out->salt,
+                            sizeof(out->salt), &out->salt_len) ||
+        !password_parse_b64(fields[f + 1], FIELD_END(f + 1), out->hash,
+                            sizeof(out->hash), &out->hash_len)) {
+        return false;
+    }
+#undef FIELD_END
+
+    return password_params_ok(&out->params);
+}
+
+static int password_derive(const password_params_t *params, JanetByteView pw,
+                           const uint8_t *salt, size_t salt_len,
+                           uint8_t *out, size_t out_len) {
+    size_t p1 = params->p1;
+
+    if (params->algo == PASSWORD_SCRYPT) {
+        p1 = (size_t)1 << params->p1;
+    }
+
+    return botan_pwdhash(password_algos[params->algo].botan_name,
+                         p1, params->p2, params->p3,
+                         out, out_len,
+                         (const char *)pw.bytes, pw.len,
+                         salt, salt_len);
+}
+
+static void password_encode(JanetBuffer *buf, const password_hash_t *h) {
+    char header[96];
+    const char *name = password_algos[h->params.algo].name;
+
+    if (password_is_argon2(h->params.algo)) {
+        snprintf(header, sizeof(header), "$%s$v=19$m=%zu,t=%zu,p=%zu$",
+                 name, h->params.p1, h->params.p2, h->params.p3);
+    } else if (h->params.algo == PASSWORD_SCRYPT) {
+        snprintf(header, sizeof(header), "$%s$ln=%zu,r=%zu,p=%zu$",
+                 name, h->params.p1, h->params.p2, h->params.p3);
+    } else {
+        snprintf(header, sizeof(header), "$%s$i=%zu$", name, h->params.p1);
+    }
+
+    janet_buffer_push_cstring(buf, header);
+
+    janet_buffer_extra(buf, (int32_t)codec_base64_encoded_len(h->salt_len, false));
+    buf->count += (int32_t)codec_base64_encode(h->salt, h->salt_len,
+                                               buf->data + buf->count, 0, false);
+    janet_buffer_push_u8(buf, '$');
+    janet_buffer_extra(buf, (int32_t)codec_base64_encoded_len(h->hash_len, false));
+    buf->count += (int32_t)codec_base64_encode(h->hash, h->hash_len,
+                                               buf->data + buf->count, 0, false);
+}
+
+/* Copies `pw` into a NUL terminated scratch string for the bcrypt API. */
+static char *password_cstring(JanetByteView pw) {
+    char *s = janet_smalloc((size_t)pw.len + 1);
+    memcpy(s, pw.bytes, pw.len);
+    s[pw.len] = 0;
+    return s;
+}
+
+static void password_free_cstring(char *s, size_t len) {
+    botan_scrub_mem(s, len + 1);
+    janet_sfree(s);
+}
+
+static bool password_needs_rehash(const password_params_t *have,
+                                  const password_params_t *want) {
+    if (have->algo != want->algo) {
+        return true;
+    }
+    return have->p1 < want->p1 || have->p2 < want->p2 || have->p3 < want->p3;
+}
+
+/* Janet functions */
+static Janet password_hash(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 3);
+    JanetByteView pw = janet_getbytes(argv, 0);
+    password_params_t params = password_get_params(argv, argc, 1);
+    botan_rng_t rng;
+    int ret;
+
+    ret = botan_rng_init(&rng, "system");
+    JANET_BOTAN_ASSERT(ret);
+
+    if (params.algo == PASSWORD_BCRYPT) {
+        uint8_t out[64];
+        size_t out_len = sizeof(out);
+        char *pass = password_cstring(pw);
+
+        ret = botan_bcrypt_generate(out, &out_len, pass, rng, params.p1, 0);
+        password_free_cstring(pass, pw.len);
+        botan_rng_destroy(rng);
+        JANET_BOTAN_ASSERT(ret);
+
+        if (out_len > 0 && out[out_len - 1] == 0) {
+            out_len--;
+        }
+        return janet_wrap_string(janet_string(out, out_len));
+    }
+
+    password_hash_t h;
+    memset(&h, 0, sizeof(h));
+    h.params = params;
+    h.salt_len = PASSWORD_SALT_LEN;
+    h.hash_len = PASSWORD_HASH_LEN;
+
+    ret = botan_rng_get(rng, h.salt, h.salt_len);
+    botan_rng_destroy(rng);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = password_derive(&params, pw, h.salt, h.salt_len, h.hash, h.hash_len);
+    if (ret < 0) {
+        botan_scrub_mem(h.hash, sizeof(h.hash));
+    }
+    JANET_BOTAN_ASSERT(ret);
+
+    JanetBuffer *buf = janet_buffer(160);
+    password_encode(buf, &h);
+    botan_scrub_mem(h.hash, sizeof(h.hash));
+
+    return janet_wrap_string(janet_string(buf->data, buf->count));
+}
+
+static Janet password_verify(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 4);
+    JanetByteView pw = janet_getbytes(argv, 0);
+    JanetByteView enc = janet_getbytes(argv, 1);
+    password_params_t want = password_get_params(argv, argc, 2);
+    password_hash_t h;
+    bool valid;
+    int ret;
+
+    if (!password_parse(enc, &h)) {
+        return janet_ckeywordv("fail");
+    }
+
+    if (h.params.algo == PASSWORD_BCRYPT) {
+        char hashed[61];
+        char *pass = password_cstring(pw);
+
+        memcpy(hashed, enc.bytes, 60);
+        hashed[60] = 0;
+        ret = botan_bcrypt_is_valid(pass, hashed);
+        password_free_cstring(pass, pw.len);
+
+        /* A negative status means Botan could not decode the hash. */
+        valid = ret == 0;
+    } else {
+        uint8_t out[PASSWORD_MAX_HASH_LEN];
+
+        ret = password_derive(&h.params, pw, h.salt, h.salt_len, out, h.hash_len);
+        if (ret < 0) {
+            botan_scrub_mem(out, sizeof(out));
+        }
+        JANET_BOTAN_ASSERT(ret);
+
+        JanetByteView expected = {h.hash, (int32_t)h.hash_len};
+        JanetByteView actual = {out, (int32_t)h.hash_len};
+        valid = ct_equal(expected, actual);
+        botan_scrub_mem(out, sizeof(out));
+    }
+
+    if (!valid) {
+        return janet_ckeywordv("fail");
+    }
+    if (password_needs_rehash(&h.params, &want)) {
+        return janet_ckeywordv("ok-needs-rehash");
+    }
+    return janet_ckeywordv("ok");
+}
+
+static Janet pwdhash_tune(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+    JanetKeyword name = janet_getkeyword(argv, 0);
+    size_t msec = janet_getsize(argv, 1);
+    size_t max_kib = janet_optsize(argv, argc, 2, 0);
+    int algo = password_find_algo(name, janet_string_length(name));
+
+    if (algo < 0 || algo == PASSWORD_BCRYPT) {
+        janet_panicf("Cannot tune password hash algorithm %v", argv[0]);
+    }
+    if (msec == 0 || msec > UINT32_MAX) {
+        janet_panic("msec is out of range");
+    }
+
+    /* Botan reports the tuned instance as iterations, parallelism and
+     * memory parameter, whatever those mean for the algorithm. */
+    size_t iterations = 0, parallelism = 0, memory = 0;
+    uint8_t salt[PASSWORD_SALT_LEN] = {0};
+    uint8_t out[PASSWORD_HASH_LEN];
+    int ret = botan_pwdhash_timed(password_algos[algo].botan_name, (uint32_t)msec,
+                                  &iterations, &parallelism, &memory,
+                                  out, sizeof(out),
+                                  "password", 8,
+                                  salt, sizeof(salt));
+    JANET_BOTAN_ASSERT(ret);
+
+    JanetKV *st;
+    if (password_is_argon2(algo)) {
+        size_t M = memory, t = iterations, p = parallelism;
+        if (max_kib > 0 && M > max_kib) {
+            /* Keep the total work roughly the same with less memory */
+            if (max_kib < 8 * p) {
+                janet_panicf("Memory cap is below the Argon2 minimum of %d KiB",
+                             (int32_t)(8 * p));
+            }
+            t = (t * M + max_kib - 1) / max_kib;
+            M = max_kib;
+        }
+        st = janet_struct_begin(3);
+        janet_struct_put(st, janet_ckeywordv("m"), janet_wrap_number((double)M));
+        janet_struct_put(st, janet_ckeywordv("t"), janet_wrap_number((double)t));
+        janet_struct_put(st, janet_ckeywordv("p"), janet_wrap_number((double)p));
+    } else if (algo == PASSWORD_SCRYPT) {
+        size_t ln = 0, r = memory, p = parallelism;
+        while (((size_t)2 << ln) <= iterations) {
+            ln++;
+        }
+        /* Scrypt uses 128 * r * N bytes; trade memory for lanes, which
+         * Botan runs one after another. */
+        while (max_kib > 0 && ln > 1 && (r << ln) / 8 > max_kib) {
+            ln--;
+            p *= 2;
+        }
+        st = janet_struct_begin(3);
+        janet_struct_put(st, janet_ckeywordv("ln"), janet_wrap_number((double)ln));
+        janet_struct_put(st, janet_ckeywordv("r"), janet_wrap_number((double)r));
+        janet_struct_put(st, janet_ckeywordv("p"), janet_wrap_number((double)p));
+    } else {
+        st = janet_struct_begin(1);
+        janet_struct_put(st, janet_ckeywordv("i"), janet_wrap_number((double)iterations));
+    }
+
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+static JanetReg password_cfuns[] = {
+    {"password/hash", password_hash,
+     "(password/hash password &opt algo params)\n\n"
+     "Hash `password` with a random salt and return it as an encoded "
+     "string that carries the algorithm and its cost parameters. `algo` is "
+     "one of :argon2id (default), :argon2i, :argon2d, :scrypt, "
+     ":pbkdf2-sha256, :pbkdf2-sha512 or :bcrypt. `params` is a struct of "
+     "cost parameters; anything omitted takes the default:\n\n"
+     "* Argon2: `{:m 19456 :t 2 :p 1}`, memory in KiB, passes, lanes\n"
+     "* scrypt: `{:ln 15 :r 8 :p 1}`, where N = 2^ln\n"
+     "* PBKDF2: `{:i 600000}`\n"
+     "* bcrypt: `{:cost 12}`\n\n"
+     "Argon2, scrypt and PBKDF2 hashes use the PHC string format, bcrypt "
+     "hashes the usual $2a$ format. Raises an error if a cost parameter "
+     "is beyond what `password/verify` accepts: Argon2 `m` up to 2 GiB, "
+     "`p` up to 64 and `m * t` up to 2^23; scrypt `ln` up to 22, `r` up to "
+     "256 and `p * r * 2^ln` up to 2^23; PBKDF2 `i` up to 10000000; bcrypt "
+     "`cost` from 4 to 18."
+    },
+    {"password/verify", password_verify,
+     "(password/verify password encoded &opt algo params)\n\n"
+     "Check `password` against a hash produced by `password/hash` (or any "
+     "compatible PHC or bcrypt string). Returns :fail if the password does "
+     "not match. Otherwise returns :ok, or :ok-needs-rehash if `encoded` "
+     "uses a different algorithm than `algo` or any cost parameter below "
+     "`params`. `algo` and `params` take the same values and defaults as "
+     "in `password/hash`, so the caller can store a fresh hash on the next "
+     "successful login. Also returns :fail if `encoded` is malformed or "
+     "its cost parameters are out of the range `password/hash` accepts, "
+     "without hashing anything."
+    },
+    {"pwdhash/tune", pwdhash_tune,
+     "(pwdhash/tune algo msec &opt max-memory)\n\n"
+     "Calibrate the cost parameters of the password hash `algo` (any of "
+     "the `password/hash` algorithms except :bcrypt) so that one hash "
+     "takes about `msec` milliseconds on this machine. `max-memory` caps "
+     "the memory use in KiB; Argon2 then makes up with more passes and "
+     "scrypt with more lanes. Returns a struct of parameters in the form "
+     "taken by `password/hash` and `password/verify`, e.g. "
+     "`{:m 65536 :t 3 :p 1}`."
+    },
+    {NULL, NULL, NULL}
+};
+
+static void submod_password(JanetTable *env) {
+    janet_cfuns(env, "botan", password_cfuns);
+}
+
+#endif /* BOTAN_PASSWORD_H */
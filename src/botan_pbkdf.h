@@ -7,19 +7,235 @@
 #ifndef BOTAN_PBKDF_H
 #define BOTAN_PBKDF_H
 
+/*
+ * Calibration cache for pbkdf-timed
+ *
+ * Tuning an iteration count for (algorithm, ms-to-run, out-len) costs
+ * about as much as the hash itself, so the result is remembered for `ttl`
+ * seconds and later calls only run the hash. The output length is part of
+ * the key because some algorithms, e.g. PBKDF2, run their iterations once
+ * per output block. The cache can also be kept in a small text file, one
+ * "algo<TAB>ms<TAB>out-len<TAB>iterations<TAB>unix-time" line per entry,
+ * so that a restarted process does not recalibrate. Whoever can write that
+ * file picks the iteration counts, so entries below PBKDF_CACHE_MIN_ITER
+ * (the SP 800-132 floor for PBKDF2) or with a timestamp in the future or
+ * older than `ttl` are dropped on load and calibrated again.
+ */
+
+#define PBKDF_CACHE_SIZE     16
+#define PBKDF_CACHE_ALGO_LEN 64
+#define PBKDF_CACHE_MIN_ITER 1000
+
+typedef struct pbkdf_cache_entry {
+    char algo[PBKDF_CACHE_ALGO_LEN];
+    size_t ms;
+    size_t out_len;
+    size_t iter;
+    int64_t tuned_at;
+} pbkdf_cache_entry_t;
+
+typedef struct pbkdf_cache {
+    pbkdf_cache_entry_t entries[PBKDF_CACHE_SIZE];
+    size_t count;
+    int64_t ttl;
+    char *path;
+} pbkdf_cache_t;
+
+static pbkdf_cache_t pbkdf_cache = {.ttl = 3600};
+
+#ifdef JANET_WINDOWS
+static SRWLOCK pbkdf_cache_lock = SRWLOCK_INIT;
+#define PBKDF_CACHE_LOCK()   AcquireSRWLockExclusive(&pbkdf_cache_lock)
+#define PBKDF_CACHE_UNLOCK() ReleaseSRWLockExclusive(&pbkdf_cache_lock)
+#else
+static pthread_mutex_t pbkdf_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define PBKDF_CACHE_LOCK()   pthread_mutex_lock(&pbkdf_cache_lock)
+#define PBKDF_CACHE_UNLOCK() pthread_mutex_unlock(&pbkdf_cache_lock)
+#endif
+
+/* Called with the lock held. */
+static pbkdf_cache_entry_t *pbkdf_cache_find(const char *algo, size_t ms, size_t out_len) {
+    for (size_t i = 0; i < pbkdf_cache.count; i++) {
+        pbkdf_cache_entry_t *e = &pbkdf_cache.entries[i];
+        if (e->ms == ms && e->out_len == out_len && strcmp(e->algo, algo) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+/* Called with the lock held. Whether a calibration made at `tuned_at` may
+ * still be used at `now`. */
+static bool pbkdf_cache_fresh(int64_t tuned_at, int64_t now) {
+    return pbkdf_cache.ttl > 0 && tuned_at <= now && now - tuned_at < pbkdf_cache.ttl;
+}
+
+/* Called with the lock held. Adds or refreshes an entry, evicting the
+ * oldest one when the cache is full. */
+static void pbkdf_cache_put(const char *algo, size_t ms, size_t out_len,
+                            size_t iter, int64_t tuned_at) {
+    if (strlen(algo) >= PBKDF_CACHE_ALGO_LEN || iter == 0) {
+        return;
+    }
+
+    pbkdf_cache_entry_t *e = pbkdf_cache_find(algo, ms, out_len);
+    if (e == NULL) {
+        if (pbkdf_cache.count < PBKDF_CACHE_SIZE) {
+            e = &pbkdf_cache.entries[pbkdf_cache.count++];
+        } else {
+            e = &pbkdf_cache.entries[0];
+            for (size_t i = 1; i < PBKDF_CACHE_SIZE; i++) {
+                if (pbkdf_cache.entries[i].tuned_at < e->tuned_at) {
+                    e = &pbkdf_cache.entries[i];
+                }
+            }
+        }
+        strcpy(e->algo, algo);
+        e->ms = ms;
+        e->out_len = out_len;
+    }
+    e->iter = iter;
+    e->tuned_at = tuned_at;
+}
+
+/* Called with the lock held. Failing to write the file only loses the
+ * persistence, so errors are ignored. */
+static void pbkdf_cache_save(void) {
+    if (pbkdf_cache.path == NULL) {
+        return;
+    }
+
+    size_t len = strlen(pbkdf_cache.path);
+    char *tmp = janet_malloc(len + 5);
+    if (tmp == NULL) {
+        return;
+    }
+    memcpy(tmp, pbkdf_cache.path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *f = fopen(tmp, "w");
+    if (f != NULL) {
+        for (size_t i = 0; i < pbkdf_cache.count; i++) {
+            pbkdf_cache_entry_t *e = &pbkdf_cache.entries[i];
+            fprintf(f, "%s\t%zu\t%zu\t%zu\t%lld\n", e->algo, e->ms,
+                    e->out_len, e->iter, (long long)e->tuned_at);
+        }
+        if (fclose(f) == 0) {
+#ifdef JANET_WINDOWS
+            remove(pbkdf_cache.path);
+#endif
+            rename(tmp, pbkdf_cache.path);
+        } else {
+            remove(tmp);
+        }
+    }
+    janet_free(tmp);
+}
+
+/* Called with the lock held. Merges the entries of the cache file, if
+ * any; malformed lines, including those of the older format without an
+ * output length, are skipped, and so are entries with too few iterations
+ * or that are not fresh. */
+static void pbkdf_cache_load(void) {
+    FILE *f = fopen(pbkdf_cache.path, "r");
+    if (f == NULL) {
+        return;
+    }
+
+    int64_t now = (int64_t)time(NULL);
+
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char algo[PBKDF_CACHE_ALGO_LEN];
+        size_t ms, out_len, iter;
+        long long tuned_at;
+        if (sscanf(line, "%63[^\t]\t%zu\t%zu\t%zu\t%lld",
+                   algo, &ms, &out_len, &iter, &tuned_at) == 5 &&
+            iter >= PBKDF_CACHE_MIN_ITER && pbkdf_cache_fresh((int64_t)tuned_at, now)) {
+            pbkdf_cache_entry_t *e = pbkdf_cache_find(algo, ms, out_len);
+            if (e == NULL || e->tuned_at < tuned_at) {
+                pbkdf_cache_put(algo, ms, out_len, iter, (int64_t)tuned_at);
+            }
+        }
+    }
+    fclose(f);
+}
+
+/* Derives with a cached iteration count for (algo, ms, out_len) when
+ * there is a fresh one, otherwise calibrates and remembers the result.
+ * Safe to call from worker threads. */
+static int pbkdf_timed_derive(const char *algo, size_t ms, size_t *iter,
+                              uint8_t *out, size_t out_len,
+                              const char *pw, size_t pw_len,
+                              const uint8_t *salt, size_t salt_len) {
+    int64_t now = (int64_t)time(NULL);
+    size_t cached = 0;
+
+    PBKDF_CACHE_LOCK();
+    pbkdf_cache_entry_t *e = pbkdf_cache_find(algo, ms, out_len);
+    if (e != NULL && pbkdf_cache_fresh(e->tuned_at, now)) {
+        cached = e->iter;
+    }
+    PBKDF_CACHE_UNLOCK();
+
+    if (cached) {
+        *iter = cached;
+        return botan_pwdhash(algo, cached, 0, 0, out, out_len,
+                             pw, pw_len, salt, salt_len);
+    }
+
+    int ret = botan_pwdhash_timed(algo, (uint32_t)ms, iter, 0, 0,
+                                  out, out_len, pw, pw_len, salt, salt_len);
+    if (ret == 0) {
+        PBKDF_CACHE_LOCK();
+        if (pbkdf_cache.ttl > 0) {
+            pbkdf_cache_put(algo, ms, out_len, *iter, now);
+            pbkdf_cache_save();
+        }
+        PBKDF_CACHE_UNLOCK();
+    }
+    return ret;
+}
+
+/* Derives through the derivation cache when `cacheable`, i.e. when the
+ * caller chose the salt. Safe to call from worker threads. */
+static int pbkdf_derive(const char *algo, size_t iter, bool cacheable,
+                        uint8_t *out, size_t out_len,
+                        JanetByteView pw, JanetByteView salt) {
+    uint8_t digest[DERIVE_CACHE_DIGEST_LEN];
+    bool cached = cacheable &&
+                  derive_cache_digest(digest, "pbkdf", algo, iter, 0, 0, out_len, pw, salt);
+
+    if (cached && derive_cache_get(digest, out, out_len)) {
+        return 0;
+    }
+
+    int ret = botan_pwdhash(algo, iter, 0, 0,
+                            out, out_len,
+                            (const char *)pw.bytes, pw.len,
+                            salt.bytes, salt.len);
+    if (ret == 0 && cached) {
+        derive_cache_put(digest, out, out_len);
+    }
+    return ret;
+}
+
 static Janet pbkdf(int32_t argc, Janet *argv) {
-    janet_arity(argc, 3, 5);
+    janet_arity(argc, 3, 6);
     const char *algo = janet_getcstring(argv, 0);
     JanetByteView pw = janet_getbytes(argv, 1);
     size_t out_len = janet_getsize(argv, 2);
-    JanetBuffer *out = janet_buffer(out_len);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+    uint8_t *out = secure_out ? secure_buffer_reserve(secure_out, out_len)
+                              : janet_smalloc(out_len);
 
     size_t iter = janet_optsize(argv, argc, 3, 100000);
     uint8_t *salt;
     size_t salt_len;
+    bool random_salt = argc < 5 || janet_checktype(argv[4], JANET_NIL);
     int ret;
 
-    if (argc == 5) {
+    if (!random_salt) {
         JanetByteView salt_data = janet_getbytes(argv, 4);
         salt = (uint8_t *)salt_data.bytes;
         salt_len = salt_data.len;
@@ -38,20 +254,27 @@ static Janet pbkdf(int32_t argc, Janet *argv) {
         JANET_BOTAN_ASSERT(ret);
     }
 
-    ret = botan_pwdhash(algo, iter, 0, 0,
-                        out->data, out_len,
-                        (char *)pw.bytes, pw.len,
-                        salt, salt_len);
+    JanetByteView salt_view = {salt, (int32_t)salt_len};
+    ret = pbkdf_derive(algo, iter, !random_salt, out, out_len, pw, salt_view);
     JANET_BOTAN_ASSERT(ret);
 
-    out->count = out_len;
+    Janet psk;
+    if (secure_out) {
+        secure_buffer_commit(secure_out, out_len);
+        psk = janet_wrap_abstract(secure_out);
+    } else {
+        psk = janet_wrap_string(janet_string(out, out_len));
+        botan_scrub_mem(out, out_len);
+        janet_sfree(out);
+    }
+
     Janet output[3] = {
         janet_wrap_string(janet_string(salt, salt_len)),
         janet_wrap_number((double)iter),
-        janet_wrap_string(janet_string(out->data, out->count))
+        psk
     };
 
-    if (argc != 5) {
+    if (random_salt) {
         janet_sfree(salt);
     }
 
@@ -59,19 +282,22 @@ static Janet pbkdf(int32_t argc, Janet *argv) {
 }
 
 static Janet pbkdf_timed(int32_t argc, Janet *argv) {
-    janet_arity(argc, 3, 5);
+    janet_arity(argc, 3, 6);
     const char *algo = janet_getcstring(argv, 0);
     JanetByteView pw = janet_getbytes(argv, 1);
     size_t out_len = janet_getsize(argv, 2);
-    JanetBuffer *out = janet_buffer(out_len);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+    uint8_t *out = secure_out ? secure_buffer_reserve(secure_out, out_len)
+                              : janet_smalloc(out_len);
 
     size_t ms_to_run = janet_optsize(argv, argc, 3, 300);
     size_t iter;
     uint8_t *salt;
     size_t salt_len;
+    bool random_salt = argc < 5 || janet_checktype(argv[4], JANET_NIL);
     int ret;
 
-    if (argc == 5) {
+    if (!random_salt) {
         JanetByteView salt_data = janet_getbytes(argv, 4);
         salt = (uint8_t *)salt_data.bytes;
         salt_len = salt_data.len;
@@ -90,45 +316,335 @@ static Janet pbkdf_timed(int32_t argc, Janet *argv) {
         JANET_BOTAN_ASSERT(ret);
     }
 
-    ret = botan_pwdhash_timed(algo, ms_to_run,
-                              &iter, 0, 0,
-                              out->data, out_len,
-                              (char *)pw.bytes, pw.len,
-                              salt, salt_len);
+    ret = pbkdf_timed_derive(algo, ms_to_run, &iter,
+                             out, out_len,
+                             (char *)pw.bytes, pw.len,
+                             salt, salt_len);
     JANET_BOTAN_ASSERT(ret);
 
-    out->count = out_len;
+    Janet psk;
+    if (secure_out) {
+        secure_buffer_commit(secure_out, out_len);
+        psk = janet_wrap_abstract(secure_out);
+    } else {
+        psk = janet_wrap_string(janet_string(out, out_len));
+        botan_scrub_mem(out, out_len);
+        janet_sfree(out);
+    }
 
     Janet output[3] = {
         janet_wrap_string(janet_string(salt, salt_len)),
         janet_wrap_number((double)iter),
-        janet_wrap_string(janet_string(out->data, out->count))
+        psk
     };
 
-    if (argc != 5) {
+    if (random_salt) {
         janet_sfree(salt);
     }
 
     return janet_wrap_tuple(janet_tuple_n(output, 3));
 }
 
+/* Async variants, also used by scrypt-async */
+typedef struct pwdhash_job {
+    jbotan_job_t job;
+    char *algo;
+    size_t param1;
+    size_t param2;
+    size_t param3;
+    size_t threads;
+    bool timed;
+    uint32_t ms_to_run;
+    uint8_t *password;
+    size_t password_len;
+    size_t password_capacity;
+    uint8_t *salt;
+    size_t salt_len;
+    uint8_t *out;
+    size_t out_len;
+    size_t out_capacity;
+    Janet secure_out;
+    bool tuple_result;
+} pwdhash_job_t;
+
+static int pwdhash_job_run(jbotan_job_t *job) {
+    pwdhash_job_t *j = (pwdhash_job_t *)job;
+
+    if (j->timed) {
+        return pbkdf_timed_derive(j->algo, j->ms_to_run, &j->param1,
+                                  j->out, j->out_len,
+                                  (const char *)j->password, j->password_len,
+                                  j->salt, j->salt_len);
+    }
+    return botan_pwdhash(j->algo, j->param1, j->param2, j->param3,
+                         j->out, j->out_len,
+                         (const char *)j->password, j->password_len,
+                         j->salt, j->salt_len);
+}
+
+static Janet pwdhash_job_finish(jbotan_job_t *job) {
+    pwdhash_job_t *j = (pwdhash_job_t *)job;
+    Janet psk;
+
+    if (janet_checktype(j->secure_out, JANET_ABSTRACT)) {
+        secure_buffer_adopt(janet_unwrap_abstract(j->secure_out),
+                            j->out, j->out_capacity, j->out_len);
+        j->out = NULL;
+        psk = j->secure_out;
+    } else {
+        psk = janet_wrap_string(janet_string(j->out, j->out_len));
+    }
+
+    if (!j->tuple_result) {
+        return psk;
+    }
+
+    Janet output[3] = {
+        janet_wrap_string(janet_string(j->salt, j->salt_len)),
+        janet_wrap_number((double)j->param1),
+        psk
+    };
+    return janet_wrap_tuple(janet_tuple_n(output, 3));
+}
+
+static void pwdhash_job_release(jbotan_job_t *job) {
+    pwdhash_job_t *j = (pwdhash_job_t *)job;
+
+    secure_arena_free(j->password, j->password_capacity);
+    secure_arena_free(j->out, j->out_capacity);
+    if (janet_checktype(j->secure_out, JANET_ABSTRACT)) {
+        janet_gcunroot(j->secure_out);
+    }
+    janet_free(j->salt);
+    janet_free(j->algo);
+    janet_free(j);
+}
+
+/* Copies every input so the job owns its data while it runs. `salt` with
+ * a NULL pointer asks for a fresh random salt of `salt.len` bytes. */
+static pwdhash_job_t *pwdhash_job_new(const char *algo, JanetByteView pw,
+                                      JanetByteView salt, size_t out_len,
+                                      botan_secure_buffer_obj_t *secure_out) {
+    pwdhash_job_t *j = janet_malloc(sizeof(pwdhash_job_t));
+    if (j == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(j, 0, sizeof(pwdhash_job_t));
+    j->job.run = pwdhash_job_run;
+    j->job.finish = pwdhash_job_finish;
+    j->job.release = pwdhash_job_release;
+    j->secure_out = janet_wrap_nil();
+
+    size_t algo_len = strlen(algo);
+    j->algo = janet_malloc(algo_len + 1);
+    j->salt = janet_malloc(salt.len > 0 ? (size_t)salt.len : 1);
+    if (j->algo == NULL || j->salt == NULL) {
+        pwdhash_job_release(&j->job);
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(j->algo, algo, algo_len + 1);
+    j->salt_len = salt.len;
+
+    if (salt.bytes) {
+        memcpy(j->salt, salt.bytes, salt.len);
+    } else {
+        botan_rng_t rng;
+        int ret = botan_rng_init(&rng, "system");
+        if (!ret) {
+            ret = botan_rng_get(rng, j->salt, j->salt_len);
+            botan_rng_destroy(rng);
+        }
+        if (ret) {
+            pwdhash_job_release(&j->job);
+            janet_panic(getBotanError(ret));
+        }
+    }
+
+    j->password = secure_arena_try_dup(pw, &j->password_capacity);
+    j->password_len = pw.len;
+    j->out = secure_arena_alloc(out_len, &j->out_capacity);
+    j->out_len = out_len;
+    if (j->password == NULL || j->out == NULL) {
+        pwdhash_job_release(&j->job);
+        janet_panic("Failed to allocate secure memory");
+    }
+
+    if (secure_out) {
+        j->secure_out = janet_wrap_abstract(secure_out);
+        janet_gcroot(j->secure_out);
+    }
+
+    return j;
+}
+
+static JanetByteView pwdhash_opt_salt(const Janet *argv, int32_t argc, int32_t n) {
+    JanetByteView salt;
+
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        return janet_getbytes(argv, n);
+    }
+    salt.bytes = NULL;
+    salt.len = 12;
+    return salt;
+}
+
+static int pbkdf_job_run(jbotan_job_t *job) {
+    pwdhash_job_t *j = (pwdhash_job_t *)job;
+    JanetByteView pw, salt;
+
+    pw.bytes = j->password;
+    pw.len = (int32_t)j->password_len;
+    salt.bytes = j->salt;
+    salt.len = (int32_t)j->salt_len;
+    return pbkdf_derive(j->algo, j->param1, true, j->out, j->out_len, pw, salt);
+}
+
+static Janet pbkdf_async(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 6);
+    const char *algo = janet_getcstring(argv, 0);
+    JanetByteView pw = janet_getbytes(argv, 1);
+    size_t out_len = janet_getsize(argv, 2);
+    size_t iter = janet_optsize(argv, argc, 3, 100000);
+    JanetByteView salt = pwdhash_opt_salt(argv, argc, 4);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+
+    pwdhash_job_t *j = pwdhash_job_new(algo, pw, salt, out_len, secure_out);
+    if (salt.bytes) {
+        j->job.run = pbkdf_job_run;
+    }
+    j->param1 = iter;
+    j->tuple_result = true;
+
+    worker_pool_await(&j->job);
+}
+
+static Janet pbkdf_timed_async(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 6);
+    const char *algo = janet_getcstring(argv, 0);
+    JanetByteView pw = janet_getbytes(argv, 1);
+    size_t out_len = janet_getsize(argv, 2);
+    size_t ms_to_run = janet_optsize(argv, argc, 3, 300);
+    JanetByteView salt = pwdhash_opt_salt(argv, argc, 4);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+
+    if (ms_to_run > UINT32_MAX) {
+        janet_panic("ms-to-run is too large");
+    }
+
+    pwdhash_job_t *j = pwdhash_job_new(algo, pw, salt, out_len, secure_out);
+    j->timed = true;
+    j->ms_to_run = (uint32_t)ms_to_run;
+    j->tuple_result = true;
+
+    worker_pool_await(&j->job);
+}
+
+static Janet pbkdf_cache_configure(int32_t argc, Janet *argv) {
+    janet_arity(argc, 0, 2);
+    bool set_ttl = argc > 0 && !janet_checktype(argv[0], JANET_NIL);
+    int64_t ttl = set_ttl ? (int64_t)janet_getsize(argv, 0) : 0;
+    bool set_path = argc > 1 && !janet_checktype(argv[1], JANET_NIL);
+    const char *path = NULL;
+
+    if (set_path && !janet_checktype(argv[1], JANET_BOOLEAN)) {
+        path = janet_getcstring(argv, 1);
+    } else if (set_path && janet_unwrap_boolean(argv[1])) {
+        janet_panic("path must be a string, nil or false");
+    }
+
+    char *path_copy = NULL;
+    if (path != NULL) {
+        size_t len = strlen(path);
+        path_copy = janet_malloc(len + 1);
+        if (path_copy == NULL) {
+            JANET_OUT_OF_MEMORY;
+        }
+        memcpy(path_copy, path, len + 1);
+    }
+
+    PBKDF_CACHE_LOCK();
+    if (set_ttl) {
+        pbkdf_cache.ttl = ttl;
+    }
+    if (set_path) {
+        janet_free(pbkdf_cache.path);
+        pbkdf_cache.path = path_copy;
+        if (path_copy != NULL) {
+            pbkdf_cache_load();
+        }
+    }
+    ttl = pbkdf_cache.ttl;
+    size_t count = pbkdf_cache.count;
+    Janet path_value = pbkdf_cache.path ? janet_cstringv(pbkdf_cache.path) : janet_wrap_nil();
+    PBKDF_CACHE_UNLOCK();
+
+    JanetKV *st = janet_struct_begin(3);
+    janet_struct_put(st, janet_ckeywordv("ttl"), janet_wrap_number((double)ttl));
+    janet_struct_put(st, janet_ckeywordv("path"), path_value);
+    janet_struct_put(st, janet_ckeywordv("entries"), janet_wrap_number((double)count));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+static Janet pbkdf_cache_clear(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 0);
+
+    PBKDF_CACHE_LOCK();
+    pbkdf_cache.count = 0;
+    pbkdf_cache_save();
+    PBKDF_CACHE_UNLOCK();
+
+    return janet_wrap_nil();
+}
+
 static JanetReg pbkdf_cfuns[] = {
     {"pbkdf", pbkdf,
-     "(pbkdf algo passphrase out-len &opt iterations salt)\n\n"
+     "(pbkdf algo passphrase out-len &opt iterations salt out)\n\n"
      "Derive a key from a `passphrase` for a number of "
      "`iterations`(default 100000) using the given PBKDF algorithm, e.g., "
      "\"PBKDF2(SHA-512)\". The `salt` can be provided or otherwise is "
      "randomly chosen. Returns `out-len` bytes of output (or potentially "
      "less depending on the algorithm and the size of the request). "
-     "Returns tuple of salt, iterations, and psk"
+     "Returns tuple of salt, iterations, and psk. If the secure buffer "
+     "`out` is given, the psk is written into it and `out` takes its place "
+     "in the tuple."
     },
     {"pbkdf-timed", pbkdf_timed,
-     "(pbkdf-timed algo passphrase out-len &opt ms-to-run salt)\n\n"
+     "(pbkdf-timed algo passphrase out-len &opt ms-to-run salt out)\n\n"
      "Derive a key from a `passphrase` for a number of "
      "Runs for as many iterations as needed to consumed `ms-to-run` "
      "milliseconds on whatever we’re running on. Returns tuple of salt, "
      "iterations, and psk. Default value of `ms-to-run` is 300 and `salt` "
-     "is 12 bytes of random values."
+     "is 12 bytes of random values. If the secure buffer `out` is given, "
+     "the psk is written into it and `out` takes its place in the tuple."
+    },
+    {"pbkdf-async", pbkdf_async,
+     "(pbkdf-async algo passphrase out-len &opt iterations salt out)\n\n"
+     "Like `pbkdf`, but the key is derived on the native worker pool while "
+     "the calling fiber yields to the event loop. Raises an error right "
+     "away if the worker pool queue is full."
+    },
+    {"pbkdf-timed-async", pbkdf_timed_async,
+     "(pbkdf-timed-async algo passphrase out-len &opt ms-to-run salt out)\n\n"
+     "Like `pbkdf-timed`, but the key is derived on the native worker pool "
+     "while the calling fiber yields to the event loop. Raises an error "
+     "right away if the worker pool queue is full."
+    },
+    {"pbkdf-cache/configure", pbkdf_cache_configure,
+     "(pbkdf-cache/configure &opt ttl path)\n\n"
+     "Configure the cache of iteration counts picked by `pbkdf-timed` and "
+     "`pbkdf-timed-async`. A calibration for an algorithm, `ms-to-run` and "
+     "`out-len` is reused for `ttl` seconds (default 3600); a `ttl` of 0 disables "
+     "the cache. If `path` is a string, the cache is loaded from and saved "
+     "to that file; `false` turns persistence off. Entries of the file with "
+     "fewer than 1000 iterations, or made in the future or more than `ttl` "
+     "seconds ago, are ignored. Omitted or nil arguments "
+     "keep the current value. Returns a struct of `:ttl`, `:path` and the "
+     "number of cached `:entries`."
+    },
+    {"pbkdf-cache/clear", pbkdf_cache_clear,
+     "(pbkdf-cache/clear)\n\n"
+     "Drop every cached calibration, so the next `pbkdf-timed` call for "
+     "each algorithm measures again."
     },
     {NULL, NULL, NULL}
 };
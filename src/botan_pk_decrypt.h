@@ -18,6 +18,7 @@ static int pk_decrypt_get_fn(void *data, Janet key, Janet *out);
 /* Janet functions */
 static Janet pk_decrypt_new(int32_t argc, Janet *argv);
 static Janet pk_decrypt_decrypt(int32_t argc, Janet *argv);
+static Janet pk_decrypt_decrypt_async(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_decrypt_obj_type = {
     "botan/pk-decrypt",
@@ -73,18 +74,28 @@ static Janet pk_decrypt_new(int32_t argc, Janet *argv) {
 }
 
 static Janet pk_decrypt_decrypt(int32_t argc, Janet *argv) {
-    janet_fixarity(argc, 2);
+    janet_arity(argc, 2, 3);
 
     int ret;
     botan_pk_decrypt_obj_t *obj = janet_getabstract(argv, 0, get_pk_decrypt_obj_type());
     botan_pk_op_decrypt_t op = obj->pk_decrypt;
 
     JanetByteView msg = janet_getbytes(argv, 1);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 2);
     size_t out_len = 0;
 
     ret = botan_pk_op_decrypt_output_length(op, msg.len, &out_len);
     JANET_BOTAN_ASSERT(ret);
 
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        ret = botan_pk_op_decrypt(op, out, &out_len, (const uint8_t *)msg.bytes, msg.len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
     JanetBuffer *out = janet_buffer(out_len);
     ret = botan_pk_op_decrypt(op, out->data, &out_len, (const uint8_t *)msg.bytes, msg.len);
     JANET_BOTAN_ASSERT(ret);
@@ -92,6 +103,82 @@ static Janet pk_decrypt_decrypt(int32_t argc, Janet *argv) {
     return janet_wrap_string(janet_string(out->data, out_len));
 }
 
+/* Async variant
+ *
+ * Like pk-sign/sign-async, the operator is created up front and owned by
+ * the job, and the private key object stays rooted until the job is
+ * released. The plaintext is kept in the secure arena until it is handed
+ * back to the fiber. */
+typedef struct pk_decrypt_job {
+    jbotan_job_t job;
+    Janet key;
+    botan_pk_op_decrypt_t op;
+    uint8_t *ciphertext;
+    size_t ciphertext_len;
+    uint8_t *out;
+    size_t out_len;
+    size_t out_capacity;
+} pk_decrypt_job_t;
+
+static int pk_decrypt_job_run(jbotan_job_t *job) {
+    pk_decrypt_job_t *j = (pk_decrypt_job_t *)job;
+    return botan_pk_op_decrypt(j->op, j->out, &j->out_len, j->ciphertext, j->ciphertext_len);
+}
+
+static Janet pk_decrypt_job_finish(jbotan_job_t *job) {
+    pk_decrypt_job_t *j = (pk_decrypt_job_t *)job;
+    return janet_wrap_string(janet_string(j->out, j->out_len));
+}
+
+static void pk_decrypt_job_release(jbotan_job_t *job) {
+    pk_decrypt_job_t *j = (pk_decrypt_job_t *)job;
+
+    botan_pk_op_decrypt_destroy(j->op);
+    janet_free(j->ciphertext);
+    secure_arena_free(j->out, j->out_capacity);
+    janet_gcunroot(j->key);
+    janet_free(j);
+}
+
+static Janet pk_decrypt_decrypt_async(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 3);
+
+    botan_private_key_obj_t *key = janet_getabstract(argv, 0, get_private_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    JanetByteView ciphertext = janet_getbytes(argv, 2);
+
+    pk_decrypt_job_t *j = janet_malloc(sizeof(pk_decrypt_job_t));
+    if (j == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(j, 0, sizeof(pk_decrypt_job_t));
+    j->job.run = pk_decrypt_job_run;
+    j->job.finish = pk_decrypt_job_finish;
+    j->job.release = pk_decrypt_job_release;
+    j->key = argv[0];
+    janet_gcroot(j->key);
+
+    int ret = botan_pk_op_decrypt_create(&j->op, key->private_key, padding, 0);
+    if (ret == 0) {
+        ret = botan_pk_op_decrypt_output_length(j->op, ciphertext.len, &j->out_len);
+    }
+    if (ret != 0) {
+        pk_decrypt_job_release(&j->job);
+        janet_panic(getBotanError(ret));
+    }
+
+    j->ciphertext_len = ciphertext.len;
+    j->ciphertext = janet_malloc(ciphertext.len + 1);
+    j->out = secure_arena_alloc(j->out_len + 1, &j->out_capacity);
+    if (j->ciphertext == NULL || j->out == NULL) {
+        pk_decrypt_job_release(&j->job);
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(j->ciphertext, ciphertext.bytes, ciphertext.len);
+
+    worker_pool_await(&j->job);
+}
+
 static JanetReg pk_decrypt_cfuns[] = {
     {"pk-decrypt/new", pk_decrypt_new,
      "(pk-decrypt/new privkey padding)\n\n"
@@ -100,8 +187,15 @@ static JanetReg pk_decrypt_cfuns[] = {
      "\"OAEP(SHA-256)\" for use with RSA). Returns `pk-decrypt-obj`."
     },
     {"pk-decrypt/decrypt", pk_decrypt_decrypt,
-     "(pk-decrypt/decrypt pk-decrypt-obj message)\n\n"
-     "Decrypt the `message` using `pk-decrypt-obj`. Returns the plaintext."
+     "(pk-decrypt/decrypt pk-decrypt-obj message &opt out)\n\n"
+     "Decrypt the `message` using `pk-decrypt-obj`. Returns the plaintext, "
+     "or writes it into the secure buffer `out` and returns it."
+    },
+    {"pk-decrypt/decrypt-async", pk_decrypt_decrypt_async,
+     "(pk-decrypt/decrypt-async privkey padding ciphertext)\n\n"
+     "Decrypt `ciphertext` with `privkey` and the `padding` scheme on the "
+     "native worker pool, while the calling fiber yields to the event loop. "
+     "Returns the plaintext."
     },
 
     {NULL, NULL, NULL}
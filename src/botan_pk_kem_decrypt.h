@@ -19,6 +19,7 @@ static int pk_kem_decrypt_get_fn(void *data, Janet key, Janet *out);
 static Janet pk_kem_decrypt_new(int32_t argc, Janet *argv);
 static Janet pk_kem_decrypt_kem_shared_key_length(int32_t argc, Janet *argv);
 static Janet pk_kem_decrypt_kem_decrypt_shared_key(int32_t argc, Janet *argv);
+static Janet pk_kem_decrypt_decapsulate_many(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_kem_decrypt_obj_type = {
     "botan/pk-kem-decrypt",
@@ -31,6 +32,7 @@ static JanetAbstractType pk_kem_decrypt_obj_type = {
 static JanetMethod pk_kem_decrypt_methods[] = {
     {"shared-key-length", pk_kem_decrypt_kem_shared_key_length},
     {"decrypt-shared-key", pk_kem_decrypt_kem_decrypt_shared_key},
+    {"decapsulate-many", pk_kem_decrypt_decapsulate_many},
     {NULL, NULL},
 };
 
@@ -90,7 +92,7 @@ static Janet pk_kem_decrypt_kem_shared_key_length(int32_t argc, Janet *argv) {
 }
 
 static Janet pk_kem_decrypt_kem_decrypt_shared_key(int32_t argc, Janet *argv) {
-    janet_fixarity(argc, 4);
+    janet_arity(argc, 4, 5);
 
     int ret;
     botan_pk_kem_decrypt_obj_t *obj = janet_getabstract(argv, 0, get_pk_kem_decrypt_obj_type());
@@ -99,11 +101,24 @@ static Janet pk_kem_decrypt_kem_decrypt_shared_key(int32_t argc, Janet *argv) {
     JanetByteView salt = janet_getbytes(argv, 1);
     size_t desired_len = janet_getsize(argv, 2);
     JanetByteView encap_key = janet_getbytes(argv, 3);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
 
     size_t shared_key_len = 0;
     ret = botan_pk_op_kem_decrypt_shared_key_length(op, desired_len, &shared_key_len);
     JANET_BOTAN_ASSERT(ret);
 
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, shared_key_len);
+        ret = botan_pk_op_kem_decrypt_shared_key(op, salt.bytes, salt.len,
+                                                 encap_key.bytes, encap_key.len,
+                                                 desired_len,
+                                                 out, &shared_key_len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, shared_key_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
     JanetBuffer *shared_key_buf = janet_buffer(shared_key_len);
     ret = botan_pk_op_kem_decrypt_shared_key(op, salt.bytes, salt.len,
                                              encap_key.bytes, encap_key.len,
@@ -114,6 +129,56 @@ static Janet pk_kem_decrypt_kem_decrypt_shared_key(int32_t argc, Janet *argv) {
     return janet_wrap_string(janet_string(shared_key_buf->data, shared_key_len));
 }
 
+static Janet pk_kem_decrypt_decapsulate_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 4, 5);
+
+    int ret;
+    botan_pk_kem_decrypt_obj_t *obj = janet_getabstract(argv, 0, get_pk_kem_decrypt_obj_type());
+    botan_pk_op_kem_decrypt_t op = obj->pk_kem_decrypt;
+
+    JanetByteView salt = janet_getbytes(argv, 1);
+    size_t desired_len = janet_getsize(argv, 2);
+    JanetView encap_keys = janet_getindexed(argv, 3);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
+    int32_t count = encap_keys.len;
+
+    JanetByteView *encap_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    for (int32_t i = 0; i < count; i++) {
+        encap_list[i] = pk_batch_bytes(encap_keys, i, "encapsulated key");
+    }
+
+    size_t shared_key_len = 0;
+    ret = botan_pk_op_kem_decrypt_shared_key_length(op, desired_len, &shared_key_len);
+    JANET_BOTAN_ASSERT(ret);
+    if (count > 0 && shared_key_len > INT32_MAX / (size_t)count) {
+        janet_panic("Total output length is too large");
+    }
+    size_t total = shared_key_len * (size_t)count;
+
+    uint8_t *out = secure_out
+        ? secure_buffer_reserve(secure_out, total)
+        : janet_string_begin((int32_t)total);
+    for (int32_t i = 0; i < count && ret == 0; i++) {
+        size_t out_len = shared_key_len;
+        ret = botan_pk_op_kem_decrypt_shared_key(op, salt.bytes, salt.len,
+                                                 encap_list[i].bytes, encap_list[i].len,
+                                                 desired_len,
+                                                 out + (size_t)i * shared_key_len, &out_len);
+    }
+
+    janet_sfree(encap_list);
+    if (ret != 0) {
+        botan_scrub_mem(out, total);
+        janet_panic(getBotanError(ret));
+    }
+
+    if (secure_out) {
+        secure_buffer_commit(secure_out, total);
+        return janet_wrap_abstract(secure_out);
+    }
+    return janet_wrap_string(janet_string_end(out));
+}
+
 static JanetReg pk_kem_decrypt_cfuns[] = {
     {"pk-kem-decrypt/new", pk_kem_decrypt_new,
      "(pk-kem-decrypt/new privkey kdf)\n\n"
@@ -131,8 +196,17 @@ static JanetReg pk_kem_decrypt_cfuns[] = {
     },
     {"pk-kem-decrypt/decrypt-shared-key", pk_kem_decrypt_kem_decrypt_shared_key,
      "(pk-kem-decrypt/decrypt-shared-key pk-kem-decrypt-obj salt "
-     "desired-key-len encapsulated-key)\n\n"
-     "Decrypt the `encapsulated-key`. Returns the shared secret."
+     "desired-key-len encapsulated-key &opt out)\n\n"
+     "Decrypt the `encapsulated-key`. Returns the shared secret, or writes "
+     "it into the secure buffer `out` and returns it."
+    },
+    {"pk-kem-decrypt/decapsulate-many", pk_kem_decrypt_decapsulate_many,
+     "(pk-kem-decrypt/decapsulate-many pk-kem-decrypt-obj salt "
+     "desired-key-len encapsulated-keys &opt out)\n\n"
+     "Decrypt every encapsulated key of the indexed collection "
+     "`encapsulated-keys` with the same operator. Returns the shared "
+     "secrets concatenated in input order, or writes them into the secure "
+     "buffer `out` and returns it."
     },
 
     {NULL, NULL, NULL}
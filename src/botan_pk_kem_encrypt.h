@@ -20,6 +20,7 @@ static Janet pk_kem_encrypt_new(int32_t argc, Janet *argv);
 static Janet pk_kem_encrypt_kem_shared_key_length(int32_t argc, Janet *argv);
 static Janet pk_kem_encrypt_kem_encapsulated_key_length(int32_t argc, Janet *argv);
 static Janet pk_kem_encrypt_kem_create_shared_key(int32_t argc, Janet *argv);
+static Janet pk_kem_encrypt_encapsulate_many(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_kem_encrypt_obj_type = {
     "botan/pk-kem-encrypt",
@@ -106,7 +107,7 @@ static Janet pk_kem_encrypt_kem_encapsulated_key_length(int32_t argc, Janet *arg
 }
 
 static Janet pk_kem_encrypt_kem_create_shared_key(int32_t argc, Janet *argv) {
-    janet_arity(argc, 3, 4);
+    janet_arity(argc, 3, 5);
 
     int ret;
     botan_pk_kem_encrypt_obj_t *obj = janet_getabstract(argv, 0, get_pk_kem_encrypt_obj_type());
@@ -128,11 +129,16 @@ static Janet pk_kem_encrypt_kem_create_shared_key(int32_t argc, Janet *argv) {
         rng = obj2->rng;
     }
 
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
+
     size_t shared_key_len = 0;
     ret = botan_pk_op_kem_encrypt_shared_key_length(op, desired_len, &shared_key_len);
     JANET_BOTAN_ASSERT(ret);
 
-    JanetBuffer *shared_key_buf = janet_buffer(shared_key_len);
+    JanetBuffer *shared_key_buf = secure_out ? NULL : janet_buffer(shared_key_len);
+    uint8_t *shared_key = secure_out
+        ? secure_buffer_reserve(secure_out, shared_key_len)
+        : shared_key_buf->data;
 
     size_t encapsulated_key_len = 0;
     ret = botan_pk_op_kem_encrypt_encapsulated_key_length(op, &encapsulated_key_len);
@@ -142,17 +148,148 @@ static Janet pk_kem_encrypt_kem_create_shared_key(int32_t argc, Janet *argv) {
 
     ret = botan_pk_op_kem_encrypt_create_shared_key(
         op, rng, salt.bytes, salt.len, desired_len,
-        shared_key_buf->data, &shared_key_len,
+        shared_key, &shared_key_len,
         encapsulated_key_buf->data, &encapsulated_key_len);
     JANET_BOTAN_ASSERT(ret);
 
-    Janet keys[2] = {
-        janet_wrap_string(janet_string(shared_key_buf->data, shared_key_len)),
-        janet_wrap_string(janet_string(encapsulated_key_buf->data, encapsulated_key_len)),
-    };
+    Janet keys[2];
+    if (secure_out) {
+        secure_buffer_commit(secure_out, shared_key_len);
+        keys[0] = janet_wrap_abstract(secure_out);
+    } else {
+        keys[0] = janet_wrap_string(janet_string(shared_key, shared_key_len));
+    }
+    keys[1] = janet_wrap_string(janet_string(encapsulated_key_buf->data, encapsulated_key_len));
     return janet_wrap_tuple(janet_tuple_n(keys, 2));
 }
 
+/* Batch encapsulation
+ *
+ * One rng serves the whole batch, and an operator is only rebuilt when
+ * the key changes from one item to the next. The shared keys and the
+ * encapsulated keys are each written into one contiguous output. */
+static Janet pk_kem_encrypt_encapsulate_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 4, 6);
+
+    int ret = 0;
+    JanetView keys = janet_getindexed(argv, 0);
+    const char *kdf = janet_getcstring(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+    size_t desired_len = janet_getsize(argv, 3);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 5);
+    int32_t count = keys.len;
+
+    botan_pubkey_t *key_list = janet_smalloc(sizeof(botan_pubkey_t) * (count + 1));
+    for (int32_t i = 0; i < count; i++) {
+        botan_public_key_obj_t *key = janet_checkabstract(keys.items[i], get_public_key_obj_type());
+        if (key == NULL) {
+            janet_panicf("expected public key at index %d, got %v", i, keys.items[i]);
+        }
+        key_list[i] = key->public_key;
+    }
+
+    botan_rng_t rng;
+    botan_rng_obj_t *obj2 = janet_optabstract(argv, argc, 4, get_rng_obj_type(), NULL);
+    if (obj2) {
+        rng = obj2->rng;
+    } else {
+        obj2 = janet_abstract(&rng_obj_type, sizeof(botan_rng_obj_t));
+        memset(obj2, 0, sizeof(botan_rng_obj_t));
+
+        ret = botan_rng_init(&obj2->rng, "system");
+        JANET_BOTAN_ASSERT(ret);
+        rng = obj2->rng;
+    }
+
+    /* The output sizes come from the first key; every other key must
+     * produce the same sizes. */
+    botan_pk_op_kem_encrypt_t op = NULL;
+    botan_pubkey_t op_key = NULL;
+    size_t shared_key_len = 0;
+    size_t encapsulated_key_len = 0;
+    if (count > 0) {
+        ret = botan_pk_op_kem_encrypt_create(&op, key_list[0], kdf);
+        if (ret == 0) {
+            ret = botan_pk_op_kem_encrypt_shared_key_length(op, desired_len, &shared_key_len);
+        }
+        if (ret == 0) {
+            ret = botan_pk_op_kem_encrypt_encapsulated_key_length(op, &encapsulated_key_len);
+        }
+        if (ret != 0) {
+            botan_pk_op_kem_encrypt_destroy(op);
+            janet_sfree(key_list);
+            janet_panic(getBotanError(ret));
+        }
+        op_key = key_list[0];
+    }
+
+    size_t item_len = shared_key_len > encapsulated_key_len ? shared_key_len : encapsulated_key_len;
+    if (count > 0 && item_len > INT32_MAX / (size_t)count) {
+        botan_pk_op_kem_encrypt_destroy(op);
+        janet_panic("Total output length is too large");
+    }
+    size_t shared_total = shared_key_len * (size_t)count;
+    size_t encapsulated_total = encapsulated_key_len * (size_t)count;
+
+    uint8_t *shared = secure_out
+        ? secure_buffer_reserve(secure_out, shared_total)
+        : janet_string_begin((int32_t)shared_total);
+    uint8_t *encapsulated = janet_string_begin((int32_t)encapsulated_total);
+
+    bool mismatch = false;
+    for (int32_t i = 0; i < count; i++) {
+        if (key_list[i] != op_key) {
+            size_t next_shared_len = 0, next_encapsulated_len = 0;
+            botan_pk_op_kem_encrypt_destroy(op);
+            op = NULL;
+            ret = botan_pk_op_kem_encrypt_create(&op, key_list[i], kdf);
+            if (ret == 0) {
+                ret = botan_pk_op_kem_encrypt_shared_key_length(op, desired_len, &next_shared_len);
+            }
+            if (ret == 0) {
+                ret = botan_pk_op_kem_encrypt_encapsulated_key_length(op, &next_encapsulated_len);
+            }
+            if (ret != 0) {
+                break;
+            }
+            if (next_shared_len != shared_key_len || next_encapsulated_len != encapsulated_key_len) {
+                mismatch = true;
+                break;
+            }
+            op_key = key_list[i];
+        }
+
+        size_t out_shared_len = shared_key_len;
+        size_t out_encapsulated_len = encapsulated_key_len;
+        ret = botan_pk_op_kem_encrypt_create_shared_key(
+            op, rng, salt.bytes, salt.len, desired_len,
+            shared + (size_t)i * shared_key_len, &out_shared_len,
+            encapsulated + (size_t)i * encapsulated_key_len, &out_encapsulated_len);
+        if (ret != 0) {
+            break;
+        }
+    }
+
+    botan_pk_op_kem_encrypt_destroy(op);
+    janet_sfree(key_list);
+    if (ret != 0 || mismatch) {
+        botan_scrub_mem(shared, shared_total);
+        if (mismatch) {
+            janet_panic("all public keys must have the same shared and encapsulated key lengths");
+        }
+        janet_panic(getBotanError(ret));
+    }
+
+    Janet result[2];
+    if (secure_out) {
+        secure_buffer_commit(secure_out, shared_total);
+        result[0] = janet_wrap_abstract(secure_out);
+    } else {
+        result[0] = janet_wrap_string(janet_string_end(shared));
+    }
+    result[1] = janet_wrap_string(janet_string_end(encapsulated));
+    return janet_wrap_tuple(janet_tuple_n(result, 2));
+}
 
 static JanetReg pk_kem_encrypt_cfuns[] = {
     {"pk-kem-encrypt/new", pk_kem_encrypt_new,
@@ -175,10 +312,23 @@ static JanetReg pk_kem_encrypt_cfuns[] = {
     },
     {"pk-kem-encrypt/create-shared-key", pk_kem_encrypt_kem_create_shared_key,
      "(pk-kem-encrypt/create-shared-key pk-kem-encrypt-obj salt "
-     "desired-key-len &opt rng)\n\n"
+     "desired-key-len &opt rng out)\n\n"
      "Create a new encapsulated key. Returns the tuple of (shared-key, "
      "encapsulated-key). New rng is used by default, if `rng` is not "
-     "provided."
+     "provided. If the secure buffer `out` is given, the shared key is "
+     "written into it and `out` takes its place in the tuple."
+    },
+    {"pk-kem-encrypt/encapsulate-many", pk_kem_encrypt_encapsulate_many,
+     "(pk-kem-encrypt/encapsulate-many pubkeys kdf salt desired-key-len "
+     "&opt rng out)\n\n"
+     "Create one encapsulated key for each public key in the indexed "
+     "collection `pubkeys`, all with the same `kdf`, `salt` and "
+     "`desired-key-len`. A single rng is used for the whole batch (new by "
+     "default, if `rng` is not provided), and the operator is reused while "
+     "consecutive items share a key. Returns the tuple of (shared-keys, "
+     "encapsulated-keys), each being the keys concatenated in input order. "
+     "If the secure buffer `out` is given, the shared keys are written into "
+     "it and it takes their place in the tuple."
     },
 
     {NULL, NULL, NULL}
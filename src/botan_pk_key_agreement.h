@@ -11,21 +11,26 @@ typedef struct botan_pk_key_agreement_obj {
     botan_pk_op_ka_t pk_key_agreement;
     uint8_t *public_value;
     size_t public_value_size;
+    Janet key;
+    botan_privkey_t private_key;
+    char *kdf;
 } botan_pk_key_agreement_obj_t;
 
 /* Abstract Object functions */
 static int pk_key_agreement_gc_fn(void *data, size_t len);
+static int pk_key_agreement_gcmark_fn(void *data, size_t len);
 static int pk_key_agreement_get_fn(void *data, Janet key, Janet *out);
 
 /* Janet functions */
 static Janet pk_key_agreement_new(int32_t argc, Janet *argv);
 static Janet pk_key_agreement_public_value(int32_t argc, Janet *argv);
 static Janet pk_key_agreement_agree(int32_t argc, Janet *argv);
+static Janet pk_key_agreement_agree_many(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_key_agreement_obj_type = {
     "botan/pk-key-agreement",
     pk_key_agreement_gc_fn,
-    NULL,
+    pk_key_agreement_gcmark_fn,
     pk_key_agreement_get_fn,
     JANET_ATEND_GET
 };
@@ -33,6 +38,7 @@ static JanetAbstractType pk_key_agreement_obj_type = {
 static JanetMethod pk_key_agreement_methods[] = {
     {"public-value", pk_key_agreement_public_value},
     {"agree", pk_key_agreement_agree},
+    {"agree-many", pk_key_agreement_agree_many},
     {NULL, NULL},
 };
 
@@ -46,10 +52,17 @@ static int pk_key_agreement_gc_fn(void *data, size_t len) {
 
     int ret = botan_pk_op_key_agreement_destroy(obj->pk_key_agreement);
     JANET_BOTAN_ASSERT(ret);
+    janet_free(obj->kdf);
 
     return 0;
 }
 
+static int pk_key_agreement_gcmark_fn(void *data, size_t len) {
+    botan_pk_key_agreement_obj_t *obj = (botan_pk_key_agreement_obj_t *)data;
+    janet_mark(obj->key);
+    return 0;
+}
+
 static int pk_key_agreement_get_fn(void *data, Janet key, Janet *out) {
     (void)data;
     if (!janet_checktype(key, JANET_KEYWORD)) {
@@ -64,6 +77,7 @@ static Janet pk_key_agreement_new(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 2);
     botan_pk_key_agreement_obj_t *obj = janet_abstract(&pk_key_agreement_obj_type, sizeof(botan_pk_key_agreement_obj_t));
     memset(obj, 0, sizeof(botan_pk_key_agreement_obj_t));
+    obj->key = janet_wrap_nil();
 
     botan_private_key_obj_t *obj2 = janet_getabstract(argv, 0, get_private_key_obj_type());
     botan_privkey_t key = obj2->private_key;
@@ -72,6 +86,16 @@ static Janet pk_key_agreement_new(int32_t argc, Janet *argv) {
     int ret = botan_pk_op_key_agreement_create(&obj->pk_key_agreement, key, kdf, 0);
     JANET_BOTAN_ASSERT(ret);
 
+    /* Kept for agree-many, which builds an operator per thread. */
+    size_t kdf_len = strlen(kdf);
+    obj->kdf = janet_malloc(kdf_len + 1);
+    if (obj->kdf == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(obj->kdf, kdf, kdf_len + 1);
+    obj->key = argv[0];
+    obj->private_key = key;
+
     view_data_t data;
     ret = botan_pk_op_key_agreement_view_public(key, &data, (botan_view_bin_fn)view_bin_func);
     JANET_BOTAN_ASSERT(ret);
@@ -95,21 +119,31 @@ static Janet pk_key_agreement_public_value(int32_t argc, Janet *argv) {
 }
 
 static Janet pk_key_agreement_agree(int32_t argc, Janet *argv) {
-    janet_arity(argc, 3, 4);
+    janet_arity(argc, 3, 5);
 
     int ret;
     botan_pk_key_agreement_obj_t *obj = janet_getabstract(argv, 0, get_pk_key_agreement_obj_type());
     botan_pk_op_ka_t op = obj->pk_key_agreement;
     JanetByteView other_key = janet_getbytes(argv, 1);
     JanetByteView salt = janet_getbytes(argv, 2);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
     size_t out_len = 0;
-    if (argc == 4) {
+    if (argc >= 4 && !janet_checktype(argv[3], JANET_NIL)) {
         out_len = janet_getsize(argv, 3);
     } else {
         ret = botan_pk_op_key_agreement_size(op, &out_len);
         JANET_BOTAN_ASSERT(ret);
     }
 
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        ret = botan_pk_op_key_agreement(op, out, &out_len, other_key.bytes, other_key.len, salt.bytes, salt.len);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
     JanetBuffer *out = janet_buffer(out_len);
     ret = botan_pk_op_key_agreement(op, out->data, &out_len, other_key.bytes, other_key.len, salt.bytes, salt.len);
     JANET_BOTAN_ASSERT(ret);
@@ -117,6 +151,144 @@ static Janet pk_key_agreement_agree(int32_t argc, Janet *argv) {
     return janet_wrap_string(janet_string(out->data, out_len));
 }
 
+/* Batch agreement
+ *
+ * Derives one key per peer public value into a single output block. Small
+ * batches use the object's own operator on the calling thread. Larger
+ * ones are split into chunks run on the calling thread and the worker
+ * pool, each chunk with its own operator, as an operator may not be used
+ * from two threads at once. */
+#define PK_KA_PARALLEL_MIN 64
+
+typedef struct pk_ka_batch {
+    botan_pk_op_ka_t op;
+    botan_privkey_t key;
+    const char *kdf;
+    const JanetByteView *peers;
+    const JanetByteView *salts;
+    uint8_t *out;
+    size_t key_len;
+    size_t count;
+    size_t chunk;
+} pk_ka_batch_t;
+
+static int pk_ka_batch_run(pk_ka_batch_t *batch, botan_pk_op_ka_t op, size_t start, size_t end) {
+    for (size_t i = start; i < end; i++) {
+        size_t out_len = batch->key_len;
+        int ret = botan_pk_op_key_agreement(op, batch->out + i * batch->key_len, &out_len,
+                                            batch->peers[i].bytes, batch->peers[i].len,
+                                            batch->salts[i].bytes, batch->salts[i].len);
+        if (ret != 0) {
+            return ret;
+        }
+        if (out_len != batch->key_len) {
+            return BOTAN_FFI_ERROR_BAD_PARAMETER;
+        }
+    }
+    return 0;
+}
+
+static int pk_ka_batch_task(void *ctx, size_t index) {
+    pk_ka_batch_t *batch = (pk_ka_batch_t *)ctx;
+    size_t start = index * batch->chunk;
+    size_t end = start + batch->chunk < batch->count ? start + batch->chunk : batch->count;
+    botan_pk_op_ka_t op;
+
+    int ret = botan_pk_op_key_agreement_create(&op, batch->key, batch->kdf, 0);
+    if (ret != 0) {
+        return ret;
+    }
+    ret = pk_ka_batch_run(batch, op, start, end);
+    botan_pk_op_key_agreement_destroy(op);
+    return ret;
+}
+
+static int pk_ka_batch_derive(pk_ka_batch_t *batch, size_t threads) {
+    if (threads <= 1 || batch->count < PK_KA_PARALLEL_MIN) {
+        return pk_ka_batch_run(batch, batch->op, 0, batch->count);
+    }
+
+    size_t chunks = threads * 4 < batch->count ? threads * 4 : batch->count;
+    batch->chunk = (batch->count + chunks - 1) / chunks;
+    chunks = (batch->count + batch->chunk - 1) / batch->chunk;
+    return worker_pool_parallel_for(pk_ka_batch_task, batch, chunks, threads);
+}
+
+static Janet pk_key_agreement_agree_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 6);
+
+    int ret;
+    botan_pk_key_agreement_obj_t *obj = janet_getabstract(argv, 0, get_pk_key_agreement_obj_type());
+    JanetView peers = janet_getindexed(argv, 1);
+    int32_t count = peers.len;
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 4);
+    size_t threads = pk_batch_threads(argv, argc, 5);
+
+    /* Salts are either absent, one salt for every peer or one per peer. */
+    JanetByteView shared_salt = {(const uint8_t *)"", 0};
+    JanetView salts = {NULL, 0};
+    bool per_peer = false;
+    if (argc > 2 && !janet_checktype(argv[2], JANET_NIL)) {
+        if (janet_bytes_view(argv[2], &shared_salt.bytes, &shared_salt.len)) {
+            per_peer = false;
+        } else {
+            salts = janet_getindexed(argv, 2);
+            if (salts.len != count) {
+                janet_panicf("expected %d salts, got %d", count, salts.len);
+            }
+            per_peer = true;
+        }
+    }
+
+    size_t key_len = 0;
+    if (argc > 3 && !janet_checktype(argv[3], JANET_NIL)) {
+        key_len = janet_getsize(argv, 3);
+    } else {
+        ret = botan_pk_op_key_agreement_size(obj->pk_key_agreement, &key_len);
+        JANET_BOTAN_ASSERT(ret);
+    }
+    if (count > 0 && key_len > INT32_MAX / (size_t)count) {
+        janet_panic("Total output length is too large");
+    }
+    size_t total = key_len * (size_t)count;
+
+    pk_ka_batch_t batch;
+    batch.op = obj->pk_key_agreement;
+    batch.key = obj->private_key;
+    batch.kdf = obj->kdf;
+    batch.key_len = key_len;
+    batch.count = (size_t)count;
+    JanetByteView *peer_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    JanetByteView *salt_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    for (int32_t i = 0; i < count; i++) {
+        peer_list[i] = pk_batch_bytes(peers, i, "public value");
+        salt_list[i] = per_peer ? pk_batch_bytes(salts, i, "salt") : shared_salt;
+    }
+    batch.peers = peer_list;
+    batch.salts = salt_list;
+
+    Janet result;
+    if (secure_out) {
+        batch.out = secure_buffer_reserve(secure_out, total);
+        ret = pk_ka_batch_derive(&batch, threads);
+        if (ret != 0) {
+            botan_scrub_mem(batch.out, total);
+        } else {
+            secure_buffer_commit(secure_out, total);
+        }
+        result = janet_wrap_abstract(secure_out);
+    } else {
+        batch.out = janet_string_begin((int32_t)total);
+        ret = pk_ka_batch_derive(&batch, threads);
+        result = janet_wrap_string(janet_string_end(batch.out));
+    }
+
+    janet_sfree(peer_list);
+    janet_sfree(salt_list);
+    JANET_BOTAN_ASSERT(ret);
+    return result;
+}
+
 static JanetReg pk_key_agreement_cfuns[] = {
     {"pk-key-agreement/new", pk_key_agreement_new,
      "(pk-key-agreement/new privkey kdf)\n\n"
@@ -129,9 +301,22 @@ static JanetReg pk_key_agreement_cfuns[] = {
     },
     {"pk-key-agreement/agree", pk_key_agreement_agree,
      "(pk-key-agreement/agree pk-key-agreement-obj other-key salt "
-     "&opt key-len)\n\n"
+     "&opt key-len out)\n\n"
      "Returns a key derived by the KDF. If `key-len` is omitted, default "
-     "agreement size will be used."
+     "agreement size will be used. If the secure buffer `out` is given, the "
+     "key is written into it and `out` is returned instead."
+    },
+    {"pk-key-agreement/agree-many", pk_key_agreement_agree_many,
+     "(pk-key-agreement/agree-many pk-key-agreement-obj other-keys "
+     "&opt salts key-len out threads)\n\n"
+     "Derive one key per public value in the indexed collection "
+     "`other-keys`. `salts` is nil for no salt, a single salt used for "
+     "every peer, or an indexed collection of one salt per peer. Every key "
+     "is `key-len` bytes long (default: the agreement size), and the keys "
+     "are returned concatenated in input order in one string, or written "
+     "into the secure buffer `out`. Batches of 64 or more are spread over "
+     "up to `threads` threads, the calling thread and the native worker "
+     "pool (default: the worker pool size)."
     },
 
     {NULL, NULL, NULL}
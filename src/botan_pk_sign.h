@@ -19,6 +19,11 @@ static int pk_sign_get_fn(void *data, Janet key, Janet *out);
 static Janet pk_sign_new(int32_t argc, Janet *argv);
 static Janet pk_sign_update(int32_t argc, Janet *argv);
 static Janet pk_sign_finish(int32_t argc, Janet *argv);
+static Janet pk_sign_finish_into(int32_t argc, Janet *argv);
+static Janet pk_sign_sign_digest(int32_t argc, Janet *argv);
+static Janet pk_sign_sign(int32_t argc, Janet *argv);
+static Janet pk_sign_sign_many(int32_t argc, Janet *argv);
+static Janet pk_sign_sign_async(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_sign_obj_type = {
     "botan/pk-sign",
@@ -31,6 +36,7 @@ static JanetAbstractType pk_sign_obj_type = {
 static JanetMethod pk_sign_methods[] = {
     {"update", pk_sign_update},
     {"finish", pk_sign_finish},
+    {"finish-into", pk_sign_finish_into},
     {NULL, NULL},
 };
 
@@ -57,6 +63,60 @@ static int pk_sign_get_fn(void *data, Janet key, Janet *out) {
     return janet_getmethod(janet_unwrap_keyword(key), pk_sign_methods, out);
 }
 
+/* Operator cache helpers */
+
+/* Returns the operator of `key` for `padding`, creating and caching it if
+ * needed. If the padding name is too long to be cached, a new operator is
+ * returned with `*owned` set, and the caller destroys it. */
+static int pk_sign_cached_op(botan_private_key_obj_t *key, const char *padding,
+                             botan_pk_op_sign_t *op, bool *owned) {
+    size_t len = strlen(padding);
+    *owned = len >= PK_OP_CACHE_PADDING_LEN;
+    if (*owned) {
+        return botan_pk_op_sign_create(op, key->private_key, padding, 0);
+    }
+
+    if (key->sign_ops == NULL) {
+        key->sign_ops = janet_malloc(sizeof(pk_sign_op_cache_t));
+        if (key->sign_ops == NULL) {
+            JANET_OUT_OF_MEMORY;
+        }
+        memset(key->sign_ops, 0, sizeof(pk_sign_op_cache_t));
+    }
+
+    pk_sign_op_cache_t *cache = key->sign_ops;
+    for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+        if (cache->ops[i] && strcmp(cache->paddings[i], padding) == 0) {
+            *op = cache->ops[i];
+            return 0;
+        }
+    }
+
+    int ret = botan_pk_op_sign_create(op, key->private_key, padding, 0);
+    if (ret != 0) {
+        return ret;
+    }
+
+    size_t slot = cache->next;
+    cache->next = (slot + 1) % PK_OP_CACHE_SLOTS;
+    botan_pk_op_sign_destroy(cache->ops[slot]);
+    cache->ops[slot] = *op;
+    memcpy(cache->paddings[slot], padding, len + 1);
+    return 0;
+}
+
+/* Destroys `op` after a failure, as it may hold a partial message. */
+static void pk_sign_drop_op(botan_private_key_obj_t *key, botan_pk_op_sign_t op) {
+    if (key->sign_ops) {
+        for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+            if (key->sign_ops->ops[i] == op) {
+                key->sign_ops->ops[i] = NULL;
+            }
+        }
+    }
+    botan_pk_op_sign_destroy(op);
+}
+
 /* Janet functions */
 static Janet pk_sign_new(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 2);
@@ -88,35 +148,419 @@ static Janet pk_sign_update(int32_t argc, Janet *argv) {
     return janet_wrap_abstract(obj);
 }
 
+/* Returns the rng argument at `n`, or a new system rng owned by the GC. */
+static botan_rng_t pk_sign_opt_rng(const Janet *argv, int32_t argc, int32_t n) {
+    botan_rng_obj_t *obj = janet_optabstract(argv, argc, n, get_rng_obj_type(), NULL);
+    if (obj == NULL) {
+        obj = janet_abstract(&rng_obj_type, sizeof(botan_rng_obj_t));
+        memset(obj, 0, sizeof(botan_rng_obj_t));
+
+        int ret = botan_rng_init(&obj->rng, "system");
+        JANET_BOTAN_ASSERT(ret);
+    }
+    return obj->rng;
+}
+
 static Janet pk_sign_finish(int32_t argc, Janet *argv) {
     janet_arity(argc, 1, 2);
 
     int ret;
     botan_pk_sign_obj_t *obj = janet_getabstract(argv, 0, get_pk_sign_obj_type());
     botan_pk_op_sign_t op = obj->pk_sign;
+    botan_rng_t rng = pk_sign_opt_rng(argv, argc, 1);
 
-    botan_rng_t rng;
-    botan_rng_obj_t *obj2 = janet_optabstract(argv, argc, 1, get_rng_obj_type(), NULL);
-    if (obj2) {
-        rng = obj2->rng;
-    } else {
-        obj2 = janet_abstract(&rng_obj_type, sizeof(botan_rng_obj_t));
-        memset(obj2, 0, sizeof(botan_rng_obj_t));
+    size_t out_len = 0;
+    ret = botan_pk_op_sign_output_length(op, &out_len);
+    JANET_BOTAN_ASSERT(ret);
 
-        ret = botan_rng_init(&obj2->rng, "system");
-        JANET_BOTAN_ASSERT(ret);
-        rng = obj2->rng;
+    uint8_t *out = janet_smalloc(out_len + 1);
+    ret = botan_pk_op_sign_finish(op, rng, out, &out_len);
+    if (ret != 0) {
+        janet_sfree(out);
+        janet_panic(getBotanError(ret));
     }
 
+    Janet sig = janet_wrap_string(janet_string(out, out_len));
+    janet_sfree(out);
+    return sig;
+}
+
+static Janet pk_sign_finish_into(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+
+    int ret;
+    botan_pk_sign_obj_t *obj = janet_getabstract(argv, 0, get_pk_sign_obj_type());
+    botan_pk_op_sign_t op = obj->pk_sign;
+    JanetBuffer *buf = janet_getbuffer(argv, 1);
+    botan_rng_t rng = pk_sign_opt_rng(argv, argc, 2);
+
     size_t out_len = 0;
     ret = botan_pk_op_sign_output_length(op, &out_len);
     JANET_BOTAN_ASSERT(ret);
 
-    JanetBuffer *out = janet_buffer(out_len);
-    ret = botan_pk_op_sign_finish(op, rng, out->data, &out_len);
+    uint8_t *out = buffer_reserve_out(buf, out_len, NULL);
+    ret = botan_pk_op_sign_finish(op, rng, out, &out_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    buf->count += (int32_t)out_len;
+    return janet_wrap_buffer(buf);
+}
+
+static Janet pk_sign_sign(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+
+    botan_private_key_obj_t *key = janet_getabstract(argv, 0, get_private_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    JanetByteView msg = janet_getbytes(argv, 2);
+    botan_rng_obj_t *rng_obj = janet_optabstract(argv, argc, 3, get_rng_obj_type(), NULL);
+    botan_rng_t rng = NULL;
+    botan_pk_op_sign_t op;
+    bool owned;
+
+    int ret = pk_sign_cached_op(key, padding, &op, &owned);
+    JANET_BOTAN_ASSERT(ret);
+
+    size_t out_len = 0;
+    uint8_t *out = NULL;
+
+    ret = botan_pk_op_sign_update(op, msg.bytes, msg.len);
+    if (ret == 0) {
+        ret = botan_pk_op_sign_output_length(op, &out_len);
+    }
+    if (ret == 0) {
+        out = janet_smalloc(out_len + 1);
+        ret = rng_obj ? 0 : botan_rng_init(&rng, "system");
+    }
+    if (ret == 0) {
+        ret = botan_pk_op_sign_finish(op, rng_obj ? rng_obj->rng : rng, out, &out_len);
+    }
+    if (rng) {
+        botan_rng_destroy(rng);
+    }
+
+    if (ret != 0 || owned) {
+        pk_sign_drop_op(key, op);
+    }
+    if (ret != 0) {
+        if (out) {
+            janet_sfree(out);
+        }
+        janet_panic(getBotanError(ret));
+    }
+
+    Janet sig = janet_wrap_string(janet_string(out, out_len));
+    janet_sfree(out);
+    return sig;
+}
+
+/* Async variant
+ *
+ * The operator is created on the calling thread, so a bad padding fails
+ * right away, and is owned by the job. The private key object stays
+ * rooted while the job is in flight so it cannot be collected under the
+ * worker. Each job uses its own system rng. */
+typedef struct pk_sign_job {
+    jbotan_job_t job;
+    Janet key;
+    botan_pk_op_sign_t op;
+    uint8_t *msg;
+    size_t msg_len;
+    uint8_t *out;
+    size_t out_len;
+} pk_sign_job_t;
+
+static int pk_sign_job_run(jbotan_job_t *job) {
+    pk_sign_job_t *j = (pk_sign_job_t *)job;
+    botan_rng_t rng;
+
+    int ret = botan_rng_init(&rng, "system");
+    if (ret != 0) {
+        return ret;
+    }
+    ret = botan_pk_op_sign_update(j->op, j->msg, j->msg_len);
+    if (ret == 0) {
+        ret = botan_pk_op_sign_finish(j->op, rng, j->out, &j->out_len);
+    }
+    botan_rng_destroy(rng);
+    return ret;
+}
+
+static Janet pk_sign_job_finish(jbotan_job_t *job) {
+    pk_sign_job_t *j = (pk_sign_job_t *)job;
+    return janet_wrap_string(janet_string(j->out, j->out_len));
+}
+
+static void pk_sign_job_release(jbotan_job_t *job) {
+    pk_sign_job_t *j = (pk_sign_job_t *)job;
+
+    botan_pk_op_sign_destroy(j->op);
+    janet_free(j->msg);
+    janet_free(j->out);
+    janet_gcunroot(j->key);
+    janet_free(j);
+}
+
+static Janet pk_sign_sign_async(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 3);
+
+    botan_private_key_obj_t *key = janet_getabstract(argv, 0, get_private_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    JanetByteView msg = janet_getbytes(argv, 2);
+
+    /* The key would be used from two threads at once. */
+    int stateful = 0;
+    int ret = botan_privkey_stateful_operation(key->private_key, &stateful);
+    if (ret == 0 && stateful) {
+        janet_panic("Stateful keys cannot be used asynchronously");
+    }
+
+    pk_sign_job_t *j = janet_malloc(sizeof(pk_sign_job_t));
+    if (j == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(j, 0, sizeof(pk_sign_job_t));
+    j->job.run = pk_sign_job_run;
+    j->job.finish = pk_sign_job_finish;
+    j->job.release = pk_sign_job_release;
+    j->key = argv[0];
+    janet_gcroot(j->key);
+
+    ret = botan_pk_op_sign_create(&j->op, key->private_key, padding, 0);
+    if (ret == 0) {
+        ret = botan_pk_op_sign_output_length(j->op, &j->out_len);
+    }
+    if (ret != 0) {
+        pk_sign_job_release(&j->job);
+        janet_panic(getBotanError(ret));
+    }
+
+    j->msg_len = msg.len;
+    j->msg = janet_malloc(msg.len + 1);
+    j->out = janet_malloc(j->out_len + 1);
+    if (j->msg == NULL || j->out == NULL) {
+        pk_sign_job_release(&j->job);
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(j->msg, msg.bytes, msg.len);
+
+    worker_pool_await(&j->job);
+}
+
+/* Prehashed signing
+ *
+ * Signs a digest computed elsewhere, for example by streaming a large file
+ * through `hash/update`, without passing the message through the signer.
+ * The padding is chosen so that the signature is the same as signing the
+ * message itself with the usual `hash-and-padding`, and verifies with it:
+ * "Raw(hash)" for DSA style keys, "PKCS1v15(Raw,hash)" or "PSS_Raw(hash)"
+ * for RSA. Returns 0 and fills `padding`, or -1 if the key type cannot
+ * sign a digest. */
+#define PK_SIGN_DIGEST_PADDING_LEN 128
+
+static int pk_sign_digest_padding(const char *algo, const char *hash, const char *scheme,
+                                  char padding[PK_SIGN_DIGEST_PADDING_LEN]) {
+    int n;
+    if (strcmp(algo, "RSA") == 0) {
+        if (scheme == NULL || strcmp(scheme, "pkcs1v15") == 0) {
+            n = snprintf(padding, PK_SIGN_DIGEST_PADDING_LEN, "PKCS1v15(Raw,%s)", hash);
+        } else if (strcmp(scheme, "pss") == 0) {
+            n = snprintf(padding, PK_SIGN_DIGEST_PADDING_LEN, "PSS_Raw(%s)", hash);
+        } else {
+            janet_panicf("unknown RSA padding :%s, expected :pkcs1v15 or :pss", scheme);
+        }
+    } else if (strcmp(algo, "ECDSA") == 0 || strcmp(algo, "DSA") == 0 ||
+               strcmp(algo, "ECGDSA") == 0) {
+        if (scheme != NULL) {
+            janet_panicf("padding :%s is only supported with RSA keys", scheme);
+        }
+        n = snprintf(padding, PK_SIGN_DIGEST_PADDING_LEN, "Raw(%s)", hash);
+    } else {
+        return -1;
+    }
+
+    if (n < 0 || n >= PK_SIGN_DIGEST_PADDING_LEN) {
+        janet_panic("hash name too long");
+    }
+    return 0;
+}
+
+static Janet pk_sign_sign_digest(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 5);
+
+    botan_private_key_obj_t *key = janet_getabstract(argv, 0, get_private_key_obj_type());
+    const char *hash_name = janet_getcstring(argv, 1);
+    JanetByteView digest = janet_getbytes(argv, 2);
+    const char *scheme = NULL;
+    if (argc > 3 && !janet_checktype(argv[3], JANET_NIL)) {
+        scheme = (const char *)janet_getkeyword(argv, 3);
+    }
+    botan_rng_obj_t *rng_obj = janet_optabstract(argv, argc, 4, get_rng_obj_type(), NULL);
+
+    char algo[32];
+    size_t algo_len = sizeof(algo);
+    int ret = botan_privkey_algo_name(key->private_key, algo, &algo_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    char padding[PK_SIGN_DIGEST_PADDING_LEN];
+    if (pk_sign_digest_padding(algo, hash_name, scheme, padding) != 0) {
+        janet_panicf("prehashed signing is not supported for %s keys", algo);
+    }
+
+    botan_hash_t hash;
+    size_t hash_len = 0;
+    ret = botan_hash_init(&hash, hash_name, 0);
+    JANET_BOTAN_ASSERT(ret);
+    ret = botan_hash_output_length(hash, &hash_len);
+    botan_hash_destroy(hash);
     JANET_BOTAN_ASSERT(ret);
 
-    return janet_wrap_string(janet_string(out->data, out_len));
+    if ((size_t)digest.len != hash_len) {
+        janet_panicf("expected a %d byte %s digest, got %d bytes",
+                     (int)hash_len, hash_name, digest.len);
+    }
+
+    Janet args[4] = {argv[0], janet_cstringv(padding), argv[2], janet_wrap_nil()};
+    if (rng_obj) {
+        args[3] = argv[4];
+    }
+    return pk_sign_sign(rng_obj ? 4 : 3, args);
+}
+
+/* Batch helpers, shared with pk-verify/verify-many */
+static JanetByteView pk_batch_bytes(JanetView view, int32_t i, const char *what) {
+    JanetByteView bytes;
+    if (!janet_bytes_view(view.items[i], &bytes.bytes, &bytes.len)) {
+        janet_panicf("expected bytes for %s at index %d, got %v", what, i, view.items[i]);
+    }
+    return bytes;
+}
+
+static size_t pk_batch_threads(const Janet *argv, int32_t argc, int32_t n) {
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        size_t threads = janet_getsize(argv, n);
+        return threads > 0 ? threads : 1;
+    }
+
+    WORKER_POOL_LOCK();
+    worker_pool_defaults();
+    size_t threads = worker_pool.threads;
+    WORKER_POOL_UNLOCK();
+    return threads;
+}
+
+/* Batch signing
+ *
+ * Like batch verification, the messages are split into contiguous chunks
+ * run on the calling thread and the worker pool. Each chunk creates its
+ * own signature operator and RNG from the shared private key. Signatures
+ * are written into fixed slots of one output block, so they come back in
+ * input order. */
+typedef struct pk_sign_batch {
+    botan_privkey_t key;
+    const char *padding;
+    const JanetByteView *messages;
+    uint8_t *signatures;
+    size_t *lengths;
+    size_t max_len;
+    size_t count;
+    size_t chunk;
+} pk_sign_batch_t;
+
+static int pk_sign_batch_task(void *ctx, size_t index) {
+    pk_sign_batch_t *batch = (pk_sign_batch_t *)ctx;
+    size_t start = index * batch->chunk;
+    size_t end = start + batch->chunk < batch->count ? start + batch->chunk : batch->count;
+    botan_pk_op_sign_t op = NULL;
+    botan_rng_t rng = NULL;
+
+    int ret = botan_pk_op_sign_create(&op, batch->key, batch->padding, 0);
+    if (ret == 0) {
+        ret = botan_rng_init(&rng, "user");
+    }
+    for (size_t i = start; i < end && ret == 0; i++) {
+        batch->lengths[i] = batch->max_len;
+        ret = botan_pk_op_sign_update(op, batch->messages[i].bytes, batch->messages[i].len);
+        if (ret == 0) {
+            ret = botan_pk_op_sign_finish(op, rng, batch->signatures + i * batch->max_len,
+                                          &batch->lengths[i]);
+        }
+    }
+
+    botan_rng_destroy(rng);
+    botan_pk_op_sign_destroy(op);
+    return ret;
+}
+
+static Janet pk_sign_sign_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+
+    botan_private_key_obj_t *key = janet_getabstract(argv, 0, get_private_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    JanetView messages = janet_getindexed(argv, 2);
+    size_t threads = pk_batch_threads(argv, argc, 3);
+    int32_t count = messages.len;
+    botan_pk_op_sign_t op;
+    bool owned;
+    int stateful = 0;
+
+    /* Check the padding and learn the signature size up front. */
+    size_t max_len = 0;
+    int ret = pk_sign_cached_op(key, padding, &op, &owned);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_pk_op_sign_output_length(op, &max_len);
+    if (owned) {
+        botan_pk_op_sign_destroy(op);
+    }
+    JANET_BOTAN_ASSERT(ret);
+
+    /* Signing with a stateful key from several threads at once could
+     * reuse its state, so such keys are signed with one thread. */
+    ret = botan_privkey_stateful_operation(key->private_key, &stateful);
+    if (ret == 0 && stateful) {
+        threads = 1;
+    }
+
+    if (count > 0 && max_len > SIZE_MAX / (size_t)count) {
+        janet_panic("Output too large");
+    }
+
+    pk_sign_batch_t batch;
+    batch.key = key->private_key;
+    batch.padding = padding;
+    batch.max_len = max_len;
+    batch.count = (size_t)count;
+    JanetByteView *message_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    batch.signatures = janet_smalloc(max_len * count + 1);
+    batch.lengths = janet_smalloc(sizeof(size_t) * (count + 1));
+
+    for (int32_t i = 0; i < count; i++) {
+        message_list[i] = pk_batch_bytes(messages, i, "message");
+    }
+    batch.messages = message_list;
+
+    size_t chunks = threads * 4 < batch.count ? threads * 4 : batch.count;
+    batch.chunk = chunks ? (batch.count + chunks - 1) / chunks : 0;
+    chunks = batch.chunk ? (batch.count + batch.chunk - 1) / batch.chunk : 0;
+
+    ret = worker_pool_parallel_for(pk_sign_batch_task, &batch, chunks, threads);
+    if (ret != 0) {
+        janet_sfree(message_list);
+        janet_sfree(batch.signatures);
+        janet_sfree(batch.lengths);
+        janet_panic(getBotanError(ret));
+    }
+
+    JanetArray *results = janet_array(count);
+    for (int32_t i = 0; i < count; i++) {
+        const uint8_t *sig = batch.signatures + (size_t)i * max_len;
+        janet_array_push(results, janet_wrap_string(janet_string(sig, (int32_t)batch.lengths[i])));
+    }
+
+    janet_sfree(message_list);
+    janet_sfree(batch.signatures);
+    janet_sfree(batch.lengths);
+    return janet_wrap_array(results);
 }
 
 static JanetReg pk_sign_cfuns[] = {
@@ -139,6 +583,46 @@ static JanetReg pk_sign_cfuns[] = {
      "the `pk-sign-obj` is reset and may be used to sign a new message. "
      "New rng is used by default, if `rng` is not provided."
     },
+    {"pk-sign/finish-into", pk_sign_finish_into,
+     "(pk-sign/finish-into pk-sign-obj buf &opt rng)\n\n"
+     "Same as `pk-sign/finish`, but appends the signature to the buffer "
+     "`buf` instead of returning a new string. Returns `buf`."
+    },
+    {"pk-sign/sign", pk_sign_sign,
+     "(pk-sign/sign privkey hash-and-padding message &opt rng)\n\n"
+     "Sign `message` with `privkey` in one call. The signature operator for "
+     "each `hash-and-padding` is created on first use and kept with "
+     "`privkey`, so signing many messages with the same key does not "
+     "rebuild it. The system rng is used if `rng` is not provided. Returns "
+     "the signature."
+    },
+    {"pk-sign/sign-async", pk_sign_sign_async,
+     "(pk-sign/sign-async privkey hash-and-padding message)\n\n"
+     "Same as `pk-sign/sign`, but the signing runs on the native worker "
+     "pool while the calling fiber yields to the event loop, which keeps "
+     "slow keys such as RSA-4096 from stalling other fibers. A new system "
+     "rng is used. Stateful keys are not supported. Returns the signature."
+    },
+    {"pk-sign/sign-digest", pk_sign_sign_digest,
+     "(pk-sign/sign-digest privkey hash digest &opt padding rng)\n\n"
+     "Sign a `digest` that was already computed with the hash function "
+     "named `hash`, for example by `hash/update` over a large file, without "
+     "hashing the message again. The signature is the same as signing the "
+     "message itself, and verifies with `pk-verify` using `hash` as "
+     "`hash-and-padding` (or \"PKCS1v15(hash)\" and \"PSS(hash)\" for "
+     "RSA). `padding` selects the RSA scheme, `:pkcs1v15` (default) or "
+     "`:pss`. Supported for RSA, DSA, ECDSA and ECGDSA keys. Returns the "
+     "signature."
+    },
+    {"pk-sign/sign-many", pk_sign_sign_many,
+     "(pk-sign/sign-many privkey hash-and-padding messages &opt threads)\n\n"
+     "Sign every message of the indexed collection `messages` with "
+     "`privkey`. The work is spread over up to `threads` threads, the "
+     "calling thread and the native worker pool (default: the worker pool "
+     "size), each with its own signature operator and rng. Stateful keys "
+     "are always signed on one thread. Returns an array of signatures in "
+     "input order."
+    },
 
     {NULL, NULL, NULL}
 };
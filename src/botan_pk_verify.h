@@ -19,6 +19,11 @@ static int pk_verify_get_fn(void *data, Janet key, Janet *out);
 static Janet pk_verify_new(int32_t argc, Janet *argv);
 static Janet pk_verify_update(int32_t argc, Janet *argv);
 static Janet pk_verify_finish(int32_t argc, Janet *argv);
+static Janet pk_verify_verify(int32_t argc, Janet *argv);
+static Janet pk_verify_verify_many(int32_t argc, Janet *argv);
+static Janet pk_verifier_prepare(int32_t argc, Janet *argv);
+static Janet pk_verifier_verify(int32_t argc, Janet *argv);
+static Janet pk_verifier_verify_many(int32_t argc, Janet *argv);
 
 static JanetAbstractType pk_verify_obj_type = {
     "botan/pk-verify",
@@ -57,6 +62,188 @@ static int pk_verify_get_fn(void *data, Janet key, Janet *out) {
     return janet_getmethod(janet_unwrap_keyword(key), pk_verify_methods, out);
 }
 
+/* Operator cache helpers */
+
+/* Returns the operator of `key` for `padding`, creating and caching it if
+ * needed. If the padding name is too long to be cached, a new operator is
+ * returned with `*owned` set, and the caller destroys it. */
+static int pk_verify_cached_op(botan_public_key_obj_t *key, const char *padding,
+                               botan_pk_op_verify_t *op, bool *owned) {
+    size_t len = strlen(padding);
+    *owned = len >= PK_OP_CACHE_PADDING_LEN;
+    if (*owned) {
+        return botan_pk_op_verify_create(op, key->public_key, padding, 0);
+    }
+
+    if (key->verify_ops == NULL) {
+        key->verify_ops = janet_malloc(sizeof(pk_verify_op_cache_t));
+        if (key->verify_ops == NULL) {
+            JANET_OUT_OF_MEMORY;
+        }
+        memset(key->verify_ops, 0, sizeof(pk_verify_op_cache_t));
+    }
+
+    pk_verify_op_cache_t *cache = key->verify_ops;
+    for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+        if (cache->ops[i] && strcmp(cache->paddings[i], padding) == 0) {
+            *op = cache->ops[i];
+            return 0;
+        }
+    }
+
+    int ret = botan_pk_op_verify_create(op, key->public_key, padding, 0);
+    if (ret != 0) {
+        return ret;
+    }
+
+    size_t slot = cache->next;
+    cache->next = (slot + 1) % PK_OP_CACHE_SLOTS;
+    botan_pk_op_verify_destroy(cache->ops[slot]);
+    cache->ops[slot] = *op;
+    memcpy(cache->paddings[slot], padding, len + 1);
+    return 0;
+}
+
+/* Destroys `op` after a failure, as it may hold a partial message. */
+static void pk_verify_drop_op(botan_public_key_obj_t *key, botan_pk_op_verify_t op) {
+    if (key->verify_ops) {
+        for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+            if (key->verify_ops->ops[i] == op) {
+                key->verify_ops->ops[i] = NULL;
+            }
+        }
+    }
+    botan_pk_op_verify_destroy(op);
+}
+
+/* Prepared verifiers
+ *
+ * Creating a verification operator is where Botan does its per-key
+ * precomputation, such as the multiplication tables for the base point
+ * and the public point of an ECDSA key. A prepared verifier keeps a pool
+ * of ready operators for one key and padding. Each verification checks
+ * one out and puts it back afterwards, so the verifier can be shared by
+ * the worker pool threads of `pk-verifier/verify-many` without ever
+ * redoing that work. */
+#define PK_VERIFIER_POOL_SLOTS 16
+
+#ifdef JANET_WINDOWS
+#define PK_VERIFIER_LOCK_T           SRWLOCK
+#define PK_VERIFIER_LOCK_INIT(v)     InitializeSRWLock(&(v)->lock)
+#define PK_VERIFIER_LOCK_DESTROY(v)  ((void)0)
+#define PK_VERIFIER_LOCK(v)          AcquireSRWLockExclusive(&(v)->lock)
+#define PK_VERIFIER_UNLOCK(v)        ReleaseSRWLockExclusive(&(v)->lock)
+#else
+#define PK_VERIFIER_LOCK_T           pthread_mutex_t
+#define PK_VERIFIER_LOCK_INIT(v)     pthread_mutex_init(&(v)->lock, NULL)
+#define PK_VERIFIER_LOCK_DESTROY(v)  pthread_mutex_destroy(&(v)->lock)
+#define PK_VERIFIER_LOCK(v)          pthread_mutex_lock(&(v)->lock)
+#define PK_VERIFIER_UNLOCK(v)        pthread_mutex_unlock(&(v)->lock)
+#endif
+
+typedef struct botan_pk_verifier_obj {
+    Janet pubkey;
+    botan_pubkey_t public_key;
+    char *padding;
+    botan_pk_op_verify_t ops[PK_VERIFIER_POOL_SLOTS];
+    size_t idle;
+    PK_VERIFIER_LOCK_T lock;
+} botan_pk_verifier_obj_t;
+
+static int pk_verifier_gc_fn(void *data, size_t len);
+static int pk_verifier_gcmark_fn(void *data, size_t len);
+static int pk_verifier_get_fn(void *data, Janet key, Janet *out);
+
+static JanetAbstractType pk_verifier_obj_type = {
+    "botan/pk-verifier",
+    pk_verifier_gc_fn,
+    pk_verifier_gcmark_fn,
+    pk_verifier_get_fn,
+    JANET_ATEND_GET
+};
+
+static JanetMethod pk_verifier_methods[] = {
+    {"verify", pk_verifier_verify},
+    {"verify-many", pk_verifier_verify_many},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_pk_verifier_obj_type() {
+    return &pk_verifier_obj_type;
+}
+
+static int pk_verifier_gc_fn(void *data, size_t len) {
+    botan_pk_verifier_obj_t *obj = (botan_pk_verifier_obj_t *)data;
+
+    for (size_t i = 0; i < obj->idle; i++) {
+        botan_pk_op_verify_destroy(obj->ops[i]);
+    }
+    janet_free(obj->padding);
+    PK_VERIFIER_LOCK_DESTROY(obj);
+    return 0;
+}
+
+static int pk_verifier_gcmark_fn(void *data, size_t len) {
+    botan_pk_verifier_obj_t *obj = (botan_pk_verifier_obj_t *)data;
+    janet_mark(obj->pubkey);
+    return 0;
+}
+
+static int pk_verifier_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), pk_verifier_methods, out);
+}
+
+/* Takes an idle operator from the pool, or creates one if all are busy.
+ * Safe to call from any thread. */
+static int pk_verifier_acquire(botan_pk_verifier_obj_t *obj, botan_pk_op_verify_t *op) {
+    PK_VERIFIER_LOCK(obj);
+    if (obj->idle > 0) {
+        *op = obj->ops[--obj->idle];
+        PK_VERIFIER_UNLOCK(obj);
+        return 0;
+    }
+    PK_VERIFIER_UNLOCK(obj);
+
+    return botan_pk_op_verify_create(op, obj->public_key, obj->padding, 0);
+}
+
+/* Returns `op` to the pool. Pass `ok` false after a failure, as the
+ * operator may then hold a partial message. */
+static void pk_verifier_release(botan_pk_verifier_obj_t *obj, botan_pk_op_verify_t op, bool ok) {
+    if (ok) {
+        PK_VERIFIER_LOCK(obj);
+        if (obj->idle < PK_VERIFIER_POOL_SLOTS) {
+            obj->ops[obj->idle++] = op;
+            op = NULL;
+        }
+        PK_VERIFIER_UNLOCK(obj);
+    }
+    botan_pk_op_verify_destroy(op);
+}
+
+/* Verifies one signature with a pooled operator. Returns 0 if valid, 1 if
+ * invalid, or another Botan error code. */
+static int pk_verifier_check(botan_pk_verifier_obj_t *obj,
+                             JanetByteView message, JanetByteView signature) {
+    botan_pk_op_verify_t op;
+    int ret = pk_verifier_acquire(obj, &op);
+    if (ret != 0) {
+        return ret;
+    }
+
+    ret = botan_pk_op_verify_update(op, message.bytes, message.len);
+    if (ret == 0) {
+        ret = botan_pk_op_verify_finish(op, signature.bytes, signature.len);
+    }
+    pk_verifier_release(obj, op, ret == 0 || ret == 1);
+    return ret;
+}
+
 /* Janet functions */
 static Janet pk_verify_new(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 2);
@@ -105,6 +292,274 @@ static Janet pk_verify_finish(int32_t argc, Janet *argv) {
     return janet_wrap_boolean(ret == 0);
 }
 
+static Janet pk_verify_verify(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 4);
+
+    botan_public_key_obj_t *key = janet_getabstract(argv, 0, get_public_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    JanetByteView msg = janet_getbytes(argv, 2);
+    JanetByteView sig = janet_getbytes(argv, 3);
+    botan_pk_op_verify_t op;
+    bool owned;
+
+    int ret = pk_verify_cached_op(key, padding, &op, &owned);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_pk_op_verify_update(op, msg.bytes, msg.len);
+    if (ret == 0) {
+        ret = botan_pk_op_verify_finish(op, sig.bytes, sig.len);
+    }
+
+    if (owned || (ret != 0 && ret != 1)) {
+        pk_verify_drop_op(key, op);
+    }
+    if (ret != 0 && ret != 1) {
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return janet_wrap_boolean(ret == 0);
+}
+
+/* Batch verification
+ *
+ * The items are split into contiguous chunks that run on the calling
+ * thread and the worker pool. Each chunk builds its own operator and
+ * reuses it while consecutive items share a key; key objects are only
+ * read, which Botan allows from several threads at once. */
+typedef struct pk_verify_batch {
+    const char *padding;
+    const botan_pubkey_t *keys;
+    const JanetByteView *messages;
+    const JanetByteView *signatures;
+    uint8_t *results;
+    size_t count;
+    size_t chunk;
+} pk_verify_batch_t;
+
+static int pk_verify_batch_task(void *ctx, size_t index) {
+    pk_verify_batch_t *batch = (pk_verify_batch_t *)ctx;
+    size_t start = index * batch->chunk;
+    size_t end = start + batch->chunk < batch->count ? start + batch->chunk : batch->count;
+    botan_pk_op_verify_t op = NULL;
+    botan_pubkey_t op_key = NULL;
+    int ret = 0;
+
+    for (size_t i = start; i < end; i++) {
+        if (op == NULL || op_key != batch->keys[i]) {
+            botan_pk_op_verify_destroy(op);
+            op = NULL;
+            ret = botan_pk_op_verify_create(&op, batch->keys[i], batch->padding, 0);
+            if (ret != 0) {
+                break;
+            }
+            op_key = batch->keys[i];
+        }
+
+        ret = botan_pk_op_verify_update(op, batch->messages[i].bytes, batch->messages[i].len);
+        if (ret == 0) {
+            ret = botan_pk_op_verify_finish(op, batch->signatures[i].bytes, batch->signatures[i].len);
+        }
+        batch->results[i] = ret == 0;
+        if (ret != 0 && ret != 1) {
+            /* Malformed signature; start over with a clean operator. */
+            botan_pk_op_verify_destroy(op);
+            op = NULL;
+        }
+        ret = 0;
+    }
+
+    botan_pk_op_verify_destroy(op);
+    return ret;
+}
+
+static Janet pk_verify_verify_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 4, 5);
+
+    const char *padding = janet_getcstring(argv, 1);
+    JanetView messages = janet_getindexed(argv, 2);
+    JanetView signatures = janet_getindexed(argv, 3);
+    size_t threads = pk_batch_threads(argv, argc, 4);
+    int32_t count = messages.len;
+
+    if (signatures.len != count) {
+        janet_panicf("expected %d signatures, got %d", count, signatures.len);
+    }
+
+    botan_public_key_obj_t *single = janet_checkabstract(argv[0], get_public_key_obj_type());
+    JanetView keys = {NULL, 0};
+    if (single == NULL) {
+        keys = janet_getindexed(argv, 0);
+        if (keys.len != count) {
+            janet_panicf("expected %d public keys, got %d", count, keys.len);
+        }
+    }
+
+    pk_verify_batch_t batch;
+    batch.padding = padding;
+    batch.count = (size_t)count;
+    botan_pubkey_t *key_list = janet_smalloc(sizeof(botan_pubkey_t) * (count + 1));
+    JanetByteView *message_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    JanetByteView *signature_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    batch.results = janet_smalloc((size_t)count + 1);
+
+    for (int32_t i = 0; i < count; i++) {
+        botan_public_key_obj_t *key = single;
+        if (key == NULL) {
+            key = janet_checkabstract(keys.items[i], get_public_key_obj_type());
+            if (key == NULL) {
+                janet_panicf("expected public key at index %d, got %v", i, keys.items[i]);
+            }
+        }
+        key_list[i] = key->public_key;
+        message_list[i] = pk_batch_bytes(messages, i, "message");
+        signature_list[i] = pk_batch_bytes(signatures, i, "signature");
+    }
+    batch.keys = key_list;
+    batch.messages = message_list;
+    batch.signatures = signature_list;
+
+    /* A few chunks per thread keep the threads busy when some items are
+     * slower than others. */
+    size_t chunks = threads * 4 < batch.count ? threads * 4 : batch.count;
+    batch.chunk = chunks ? (batch.count + chunks - 1) / chunks : 0;
+    chunks = batch.chunk ? (batch.count + batch.chunk - 1) / batch.chunk : 0;
+
+    int ret = worker_pool_parallel_for(pk_verify_batch_task, &batch, chunks, threads);
+    JANET_BOTAN_ASSERT(ret);
+
+    JanetArray *results = janet_array(count);
+    for (int32_t i = 0; i < count; i++) {
+        janet_array_push(results, janet_wrap_boolean(batch.results[i]));
+    }
+
+    janet_sfree(key_list);
+    janet_sfree(message_list);
+    janet_sfree(signature_list);
+    janet_sfree(batch.results);
+    return janet_wrap_array(results);
+}
+
+typedef struct pk_verifier_batch {
+    botan_pk_verifier_obj_t *verifier;
+    const JanetByteView *messages;
+    const JanetByteView *signatures;
+    uint8_t *results;
+    size_t count;
+    size_t chunk;
+} pk_verifier_batch_t;
+
+static int pk_verifier_batch_task(void *ctx, size_t index) {
+    pk_verifier_batch_t *batch = (pk_verifier_batch_t *)ctx;
+    size_t start = index * batch->chunk;
+    size_t end = start + batch->chunk < batch->count ? start + batch->chunk : batch->count;
+
+    for (size_t i = start; i < end; i++) {
+        int ret = pk_verifier_check(batch->verifier, batch->messages[i], batch->signatures[i]);
+        batch->results[i] = ret == 0;
+    }
+    return 0;
+}
+
+static Janet pk_verifier_prepare(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+
+    botan_public_key_obj_t *key = janet_getabstract(argv, 0, get_public_key_obj_type());
+    const char *padding = janet_getcstring(argv, 1);
+    size_t warm = argc > 2 ? janet_getsize(argv, 2) : 1;
+    if (warm == 0 || warm > PK_VERIFIER_POOL_SLOTS) {
+        janet_panicf("expected between 1 and %d operators, got %d",
+                     PK_VERIFIER_POOL_SLOTS, (int)warm);
+    }
+
+    /* Build the first operator before the object exists, so that a bad
+     * padding fails early. */
+    botan_pk_op_verify_t first;
+    int ret = botan_pk_op_verify_create(&first, key->public_key, padding, 0);
+    JANET_BOTAN_ASSERT(ret);
+
+    botan_pk_verifier_obj_t *obj = janet_abstract(&pk_verifier_obj_type, sizeof(botan_pk_verifier_obj_t));
+    memset(obj, 0, sizeof(botan_pk_verifier_obj_t));
+    PK_VERIFIER_LOCK_INIT(obj);
+    obj->pubkey = argv[0];
+    obj->public_key = key->public_key;
+    obj->ops[obj->idle++] = first;
+
+    size_t padding_len = strlen(padding);
+    obj->padding = janet_malloc(padding_len + 1);
+    if (obj->padding == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memcpy(obj->padding, padding, padding_len + 1);
+
+    while (obj->idle < warm) {
+        ret = botan_pk_op_verify_create(&obj->ops[obj->idle], key->public_key, padding, 0);
+        JANET_BOTAN_ASSERT(ret);
+        obj->idle++;
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet pk_verifier_verify(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 3);
+
+    botan_pk_verifier_obj_t *obj = janet_getabstract(argv, 0, get_pk_verifier_obj_type());
+    JanetByteView message = janet_getbytes(argv, 1);
+    JanetByteView signature = janet_getbytes(argv, 2);
+
+    int ret = pk_verifier_check(obj, message, signature);
+    if (ret != 0 && ret != 1) {
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return janet_wrap_boolean(ret == 0);
+}
+
+static Janet pk_verifier_verify_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 4);
+
+    botan_pk_verifier_obj_t *obj = janet_getabstract(argv, 0, get_pk_verifier_obj_type());
+    JanetView messages = janet_getindexed(argv, 1);
+    JanetView signatures = janet_getindexed(argv, 2);
+    size_t threads = pk_batch_threads(argv, argc, 3);
+    int32_t count = messages.len;
+
+    if (signatures.len != count) {
+        janet_panicf("expected %d signatures, got %d", count, signatures.len);
+    }
+
+    pk_verifier_batch_t batch;
+    batch.verifier = obj;
+    batch.count = (size_t)count;
+    JanetByteView *message_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    JanetByteView *signature_list = janet_smalloc(sizeof(JanetByteView) * (count + 1));
+    batch.results = janet_smalloc((size_t)count + 1);
+
+    for (int32_t i = 0; i < count; i++) {
+        message_list[i] = pk_batch_bytes(messages, i, "message");
+        signature_list[i] = pk_batch_bytes(signatures, i, "signature");
+    }
+    batch.messages = message_list;
+    batch.signatures = signature_list;
+
+    size_t chunks = threads * 4 < batch.count ? threads * 4 : batch.count;
+    batch.chunk = chunks ? (batch.count + chunks - 1) / chunks : 0;
+    chunks = batch.chunk ? (batch.count + batch.chunk - 1) / batch.chunk : 0;
+
+    int ret = worker_pool_parallel_for(pk_verifier_batch_task, &batch, chunks, threads);
+    JANET_BOTAN_ASSERT(ret);
+
+    JanetArray *results = janet_array(count);
+    for (int32_t i = 0; i < count; i++) {
+        janet_array_push(results, janet_wrap_boolean(batch.results[i]));
+    }
+
+    janet_sfree(message_list);
+    janet_sfree(signature_list);
+    janet_sfree(batch.results);
+    return janet_wrap_array(results);
+}
+
 static JanetReg pk_verify_cfuns[] = {
     {"pk-verify/new", pk_verify_new,
      "(pk-verify/new pubkey hash-and-padding)\n\n"
@@ -124,6 +579,44 @@ static JanetReg pk_verify_cfuns[] = {
      "Verify if the `signature` provided matches with the message "
      "provided. Returns boolean."
     },
+    {"pk-verify/verify", pk_verify_verify,
+     "(pk-verify/verify pubkey hash-and-padding message signature)\n\n"
+     "Verify `signature` over `message` with `pubkey` in one call. The "
+     "verification operator for each `hash-and-padding` is created on "
+     "first use and kept with `pubkey`, so verifying many messages with "
+     "the same key does not rebuild it. Returns boolean."
+    },
+    {"pk-verify/verify-many", pk_verify_verify_many,
+     "(pk-verify/verify-many pubkeys hash-and-padding messages signatures &opt threads)\n\n"
+     "Verify many signatures in one call. `messages` and `signatures` are "
+     "indexed collections of the same length, and `pubkeys` is either one "
+     "public key for all of them or an indexed collection of keys in the "
+     "same order. The work is spread over up to `threads` threads, the "
+     "calling thread and the native worker pool (default: the worker pool "
+     "size). Returns an array of booleans in input order; a malformed "
+     "signature counts as invalid."
+    },
+    {"pubkey/prepare-verifier", pk_verifier_prepare,
+     "(pubkey/prepare-verifier pubkey hash-and-padding &opt operators)\n\n"
+     "Prepare `pubkey` for repeated verification with `hash-and-padding`. "
+     "The verifier keeps a pool of ready verification operators, with "
+     "`operators` of them (default 1, at most 16) built up front, so the "
+     "per-key precomputation such as the ECDSA multiplication tables is "
+     "done once and reused. The verifier is safe to use from the worker "
+     "pool threads of `pk-verifier/verify-many`. Returns `pk-verifier-obj`."
+    },
+    {"pk-verifier/verify", pk_verifier_verify,
+     "(pk-verifier/verify pk-verifier-obj message signature)\n\n"
+     "Verify `signature` over `message` with a prepared verifier. Returns "
+     "boolean."
+    },
+    {"pk-verifier/verify-many", pk_verifier_verify_many,
+     "(pk-verifier/verify-many pk-verifier-obj messages signatures &opt threads)\n\n"
+     "Verify many signatures with a prepared verifier, spread over up to "
+     "`threads` threads, the calling thread and the native worker pool "
+     "(default: the worker pool size). Returns an array of booleans in "
+     "input order; a malformed signature counts as invalid."
+    },
 
     {NULL, NULL, NULL}
 };
@@ -131,6 +624,7 @@ static JanetReg pk_verify_cfuns[] = {
 static void submod_pk_verify(JanetTable *env) {
     janet_cfuns(env, "botan", pk_verify_cfuns);
     janet_register_abstract_type(get_pk_verify_obj_type());
+    janet_register_abstract_type(get_pk_verifier_obj_type());
 }
 
 #endif /* BOTAN_PK_VERIFY_H */
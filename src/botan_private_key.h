@@ -7,8 +7,15 @@
 #ifndef BOTAN_PRIVATE_KEY_H
 #define BOTAN_PRIVATE_KEY_H
 
+typedef struct pk_sign_op_cache {
+    botan_pk_op_sign_t ops[PK_OP_CACHE_SLOTS];
+    char paddings[PK_OP_CACHE_SLOTS][PK_OP_CACHE_PADDING_LEN];
+    size_t next;
+} pk_sign_op_cache_t;
+
 typedef struct botan_private_key_obj {
     botan_privkey_t private_key;
+    pk_sign_op_cache_t *sign_ops;
 } botan_private_key_obj_t;
 
 /* Abstract Object functions */
@@ -69,6 +76,13 @@ static JanetAbstractType *get_private_key_obj_type() {
 static int private_key_gc_fn(void *data, size_t len) {
     botan_private_key_obj_t *obj = (botan_private_key_obj_t *)data;
 
+    if (obj->sign_ops) {
+        for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+            botan_pk_op_sign_destroy(obj->sign_ops->ops[i]);
+        }
+        janet_free(obj->sign_ops);
+    }
+
     int ret = botan_privkey_destroy(obj->private_key);
     JANET_BOTAN_ASSERT(ret);
 
@@ -539,10 +553,18 @@ static Janet private_key_to_encrypted_der(int32_t argc, Janet *argv) {
 }
 
 static Janet private_key_to_raw(int32_t argc, Janet *argv) {
-    janet_fixarity(argc, 1);
+    janet_arity(argc, 1, 2);
 
     botan_private_key_obj_t *obj = janet_getabstract(argv, 0, get_private_key_obj_type());
     botan_privkey_t key = obj->private_key;
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 1);
+
+    if (secure_out) {
+        int ret = botan_privkey_view_raw(key, secure_out, (botan_view_bin_fn)view_secure_func);
+        JANET_BOTAN_ASSERT(ret);
+
+        return janet_wrap_abstract(secure_out);
+    }
 
     view_data_t data;
     int ret = botan_privkey_view_raw(key, &data, (botan_view_bin_fn)view_bin_func);
@@ -804,9 +826,11 @@ static JanetReg private_key_cfuns[] = {
      "Return the DER encoding of the private key encrypted with `passphrase`."
     },
     {"privkey/to-raw", private_key_to_raw,
-     "(privkey/to-raw privkey)\n\n"
+     "(privkey/to-raw privkey &opt out)\n\n"
      "Return the unencrypted canonical raw encoding of the private key. "
-     "This might not be defined for all key types."
+     "This might not be defined for all key types. If the secure buffer "
+     "`out` is given, the encoding is written into it and `out` is "
+     "returned instead."
     },
     {"privkey/check-key", private_key_check_key,
      "(privkey/check-key privkey rng &opt weak)\n\n"
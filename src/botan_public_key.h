@@ -7,8 +7,22 @@
 #ifndef BOTAN_PUBLIC_KEY_H
 #define BOTAN_PUBLIC_KEY_H
 
+/* Operators created by the one-shot pk-verify/verify and pk-sign/sign are
+ * kept on the key object, one per padding, so that repeated use of a key
+ * does not parse the padding and build an operator every time. They are
+ * destroyed before the key itself. */
+#define PK_OP_CACHE_SLOTS       4
+#define PK_OP_CACHE_PADDING_LEN 64
+
+typedef struct pk_verify_op_cache {
+    botan_pk_op_verify_t ops[PK_OP_CACHE_SLOTS];
+    char paddings[PK_OP_CACHE_SLOTS][PK_OP_CACHE_PADDING_LEN];
+    size_t next;
+} pk_verify_op_cache_t;
+
 typedef struct botan_public_key_obj {
     botan_pubkey_t public_key;
+    pk_verify_op_cache_t *verify_ops;
 } botan_public_key_obj_t;
 
 /* Abstract Object functions */
@@ -62,6 +76,13 @@ static JanetAbstractType *get_public_key_obj_type() {
 static int public_key_gc_fn(void *data, size_t len) {
     botan_public_key_obj_t *obj = (botan_public_key_obj_t *)data;
 
+    if (obj->verify_ops) {
+        for (size_t i = 0; i < PK_OP_CACHE_SLOTS; i++) {
+            botan_pk_op_verify_destroy(obj->verify_ops->ops[i]);
+        }
+        janet_free(obj->verify_ops);
+    }
+
     int ret = botan_pubkey_destroy(obj->public_key);
     JANET_BOTAN_ASSERT(ret);
 
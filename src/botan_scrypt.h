@@ -7,34 +7,267 @@
 #ifndef BOTAN_SCRYPT_H
 #define BOTAN_SCRYPT_H
 
+/*
+ * Parallel scrypt lanes
+ *
+ * Scrypt is PBKDF2-HMAC-SHA256 around p independent ROMix lanes (RFC
+ * 7914). Botan runs the lanes one after another, so when more than one
+ * thread is asked for, the PBKDF2 steps still go through Botan and the
+ * ROMix lanes run here on the worker pool. The output is the same; the
+ * memory use grows to 128 * r * N bytes per lane running at once.
+ */
+
+typedef struct scrypt_lanes {
+    uint8_t *B;
+    size_t N;
+    size_t r;
+} scrypt_lanes_t;
+
+static uint32_t scrypt_load_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void scrypt_store_le32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+#define SCRYPT_ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
+
+static void scrypt_salsa20_8(uint32_t B[16]) {
+    uint32_t x[16];
+    memcpy(x, B, sizeof(x));
+
+    for (int i = 0; i < 8; i += 2) {
+        x[ 4] ^= SCRYPT_ROTL(x[ 0] + x[12],  7);  x[ 8] ^= SCRYPT_ROTL(x[ 4] + x[ 0],  9);
+        x[12] ^= SCRYPT_ROTL(x[ 8] + x[ 4], 13);  x[ 0] ^= SCRYPT_ROTL(x[12] + x[ 8], 18);
+        x[ 9] ^= SCRYPT_ROTL(x[ 5] + x[ 1],  7);  x[13] ^= SCRYPT_ROTL(x[ 9] + x[ 5],  9);
+        x[ 1] ^= SCRYPT_ROTL(x[13] + x[ 9], 13);  x[ 5] ^= SCRYPT_ROTL(x[ 1] + x[13], 18);
+        x[14] ^= SCRYPT_ROTL(x[10] + x[ 6],  7);  x[ 2] ^= SCRYPT_ROTL(x[14] + x[10],  9);
+        x[ 6] ^= SCRYPT_ROTL(x[ 2] + x[14], 13);  x[10] ^= SCRYPT_ROTL(x[ 6] + x[ 2], 18);
+        x[ 3] ^= SCRYPT_ROTL(x[15] + x[11],  7);  x[ 7] ^= SCRYPT_ROTL(x[ 3] + x[15],  9);
+        x[11] ^= SCRYPT_ROTL(x[ 7] + x[ 3], 13);  x[15] ^= SCRYPT_ROTL(x[11] + x[ 7], 18);
+        x[ 1] ^= SCRYPT_ROTL(x[ 0] + x[ 3],  7);  x[ 2] ^= SCRYPT_ROTL(x[ 1] + x[ 0],  9);
+        x[ 3] ^= SCRYPT_ROTL(x[ 2] + x[ 1], 13);  x[ 0] ^= SCRYPT_ROTL(x[ 3] + x[ 2], 18);
+        x[ 6] ^= SCRYPT_ROTL(x[ 5] + x[ 4],  7);  x[ 7] ^= SCRYPT_ROTL(x[ 6] + x[ 5],  9);
+        x[ 4] ^= SCRYPT_ROTL(x[ 7] + x[ 6], 13);  x[ 5] ^= SCRYPT_ROTL(x[ 4] + x[ 7], 18);
+        x[11] ^= SCRYPT_ROTL(x[10] + x[ 9],  7);  x[ 8] ^= SCRYPT_ROTL(x[11] + x[10],  9);
+        x[ 9] ^= SCRYPT_ROTL(x[ 8] + x[11], 13);  x[10] ^= SCRYPT_ROTL(x[ 9] + x[ 8], 18);
+        x[12] ^= SCRYPT_ROTL(x[15] + x[14],  7);  x[13] ^= SCRYPT_ROTL(x[12] + x[15],  9);
+        x[14] ^= SCRYPT_ROTL(x[13] + x[12], 13);  x[15] ^= SCRYPT_ROTL(x[14] + x[13], 18);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        B[i] += x[i];
+    }
+}
+
+/* BlockMix of the 2r 64-byte blocks in `B` into `Y`. */
+static void scrypt_block_mix(const uint32_t *B, uint32_t *Y, size_t r) {
+    uint32_t X[16];
+    memcpy(X, &B[(2 * r - 1) * 16], sizeof(X));
+
+    for (size_t i = 0; i < 2 * r; i++) {
+        for (int k = 0; k < 16; k++) {
+            X[k] ^= B[i * 16 + k];
+        }
+        scrypt_salsa20_8(X);
+        memcpy(&Y[((i & 1) * r + i / 2) * 16], X, sizeof(X));
+    }
+}
+
+/* ROMix of one lane of 128 * r bytes, in place. */
+static int scrypt_romix(uint8_t *lane, size_t N, size_t r) {
+    size_t words = 32 * r;
+    uint32_t *V = janet_malloc(sizeof(uint32_t) * words * (N + 2));
+    if (V == NULL) {
+        return BOTAN_FFI_ERROR_OUT_OF_MEMORY;
+    }
+    uint32_t *X = V + words * N;
+    uint32_t *Y = X + words;
+
+    for (size_t k = 0; k < words; k++) {
+        X[k] = scrypt_load_le32(lane + 4 * k);
+    }
+    for (size_t i = 0; i < N; i++) {
+        memcpy(V + words * i, X, sizeof(uint32_t) * words);
+        scrypt_block_mix(X, Y, r);
+        memcpy(X, Y, sizeof(uint32_t) * words);
+    }
+    for (size_t i = 0; i < N; i++) {
+        const uint32_t *last = &X[(2 * r - 1) * 16];
+        size_t j = (size_t)(((uint64_t)last[1] << 32 | last[0]) & (N - 1));
+        for (size_t k = 0; k < words; k++) {
+            X[k] ^= V[words * j + k];
+        }
+        scrypt_block_mix(X, Y, r);
+        memcpy(X, Y, sizeof(uint32_t) * words);
+    }
+    for (size_t k = 0; k < words; k++) {
+        scrypt_store_le32(lane + 4 * k, X[k]);
+    }
+
+    botan_scrub_mem(V, sizeof(uint32_t) * words * (N + 2));
+    janet_free(V);
+    return 0;
+}
+
+static int scrypt_lane_task(void *ctx, size_t index) {
+    scrypt_lanes_t *lanes = (scrypt_lanes_t *)ctx;
+    return scrypt_romix(lanes->B + index * 128 * lanes->r, lanes->N, lanes->r);
+}
+
+/* Parameter limits of Botan's Scrypt */
+#define SCRYPT_MAX_N (1 << 22)
+#define SCRYPT_MAX_R 256
+#define SCRYPT_MAX_P 1024
+
+/* Whether the lanes can be split off: the parameters must be ones Botan
+ * accepts, so that anything else still gets Botan's error. */
+static bool scrypt_lanes_supported(size_t N, size_t r, size_t p) {
+    return N > 1 && N <= SCRYPT_MAX_N && (N & (N - 1)) == 0 &&
+           r > 0 && r <= SCRYPT_MAX_R && p > 1 && p <= SCRYPT_MAX_P &&
+           r <= SIZE_MAX / 128 / p && N <= SIZE_MAX / (128 * r) - 2;
+}
+
+static int scrypt_parallel(size_t N, size_t r, size_t p, size_t threads,
+                           uint8_t *out, size_t out_len,
+                           JanetByteView pass, JanetByteView salt) {
+    size_t B_len = 128 * r * p;
+    uint8_t *B = janet_malloc(B_len);
+    if (B == NULL) {
+        return BOTAN_FFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    int ret = botan_pwdhash("PBKDF2(HMAC(SHA-256))", 1, 0, 0,
+                            B, B_len,
+                            (const char *)pass.bytes, pass.len,
+                            salt.bytes, salt.len);
+    if (ret == 0) {
+        scrypt_lanes_t lanes = {B, N, r};
+        ret = worker_pool_parallel_for(scrypt_lane_task, &lanes, p, threads);
+    }
+    if (ret == 0) {
+        ret = botan_pwdhash("PBKDF2(HMAC(SHA-256))", 1, 0, 0,
+                            out, out_len,
+                            (const char *)pass.bytes, pass.len,
+                            B, B_len);
+    }
+
+    botan_scrub_mem(B, B_len);
+    janet_free(B);
+    return ret;
+}
+
+static int scrypt_derive(size_t N, size_t r, size_t p, size_t threads,
+                         uint8_t *out, size_t out_len,
+                         JanetByteView pass, JanetByteView salt) {
+    uint8_t digest[DERIVE_CACHE_DIGEST_LEN];
+    bool cached = derive_cache_digest(digest, "scrypt", "", N, r, p, out_len, pass, salt);
+
+    if (cached && derive_cache_get(digest, out, out_len)) {
+        return 0;
+    }
+
+    int ret;
+    if (threads > 1 && scrypt_lanes_supported(N, r, p)) {
+        ret = scrypt_parallel(N, r, p, threads, out, out_len, pass, salt);
+    } else {
+        ret = botan_pwdhash("Scrypt", N, r, p,
+                            out, out_len,
+                            (const char *)pass.bytes, pass.len,
+                            salt.bytes, salt.len);
+    }
+    if (ret == 0 && cached) {
+        derive_cache_put(digest, out, out_len);
+    }
+    return ret;
+}
+
 static Janet scrypt(int32_t argc, Janet *argv) {
-    janet_arity(argc, 3, 6);
+    janet_arity(argc, 3, 8);
     size_t out_len = janet_getsize(argv, 0);
     JanetByteView pass = janet_getbytes(argv, 1);
     JanetByteView salt = janet_getbytes(argv, 2);
-    JanetBuffer *out = janet_buffer(out_len);
 
     size_t N = janet_optsize(argv, argc, 3, 1024);
     size_t r = janet_optsize(argv, argc, 4, 8);
     size_t p = janet_optsize(argv, argc, 5, 8);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 6);
+    size_t threads = janet_optsize(argv, argc, 7, 1);
     int ret;
 
-    ret = botan_pwdhash("Scrypt", N, r, p,
-                        out->data, out_len,
-                        (const char *)pass.bytes, pass.len,
-                        salt.bytes, salt.len);
+    if (secure_out) {
+        uint8_t *out = secure_buffer_reserve(secure_out, out_len);
+        ret = scrypt_derive(N, r, p, threads, out, out_len, pass, salt);
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, out_len);
+        return janet_wrap_abstract(secure_out);
+    }
+
+    JanetBuffer *out = janet_buffer(out_len);
+    ret = scrypt_derive(N, r, p, threads, out->data, out_len, pass, salt);
     JANET_BOTAN_ASSERT(ret);
 
     out->count = out_len;
     return janet_wrap_string(janet_string(out->data, out->count));
 }
 
+static int scrypt_job_run(jbotan_job_t *job) {
+    pwdhash_job_t *j = (pwdhash_job_t *)job;
+    JanetByteView pass, salt;
+
+    pass.bytes = j->password;
+    pass.len = (int32_t)j->password_len;
+    salt.bytes = j->salt;
+    salt.len = (int32_t)j->salt_len;
+    return scrypt_derive(j->param1, j->param2, j->param3, j->threads,
+                         j->out, j->out_len, pass, salt);
+}
+
+static Janet scrypt_async(int32_t argc, Janet *argv) {
+    janet_arity(argc, 3, 8);
+    size_t out_len = janet_getsize(argv, 0);
+    JanetByteView pass = janet_getbytes(argv, 1);
+    JanetByteView salt = janet_getbytes(argv, 2);
+    size_t N = janet_optsize(argv, argc, 3, 1024);
+    size_t r = janet_optsize(argv, argc, 4, 8);
+    size_t p = janet_optsize(argv, argc, 5, 8);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 6);
+    size_t threads = janet_optsize(argv, argc, 7, 1);
+
+    pwdhash_job_t *j = pwdhash_job_new("Scrypt", pass, salt, out_len, secure_out);
+    j->job.run = scrypt_job_run;
+    j->param1 = N;
+    j->param2 = r;
+    j->param3 = p;
+    j->threads = threads;
+
+    worker_pool_await(&j->job);
+}
+
 static JanetReg scrypt_cfuns[] = {
     {"scrypt", scrypt,
-     "(scrypt out-len password salt &opt N r p)\n\n"
+     "(scrypt out-len password salt &opt N r p out threads)\n\n"
      "Runs Scrypt key derivation function over the specified password and "
      "salt using Scrypt parameters N, r, p. If omitted, the default values "
-     "of N=1024, r=8, p=8 are used."
+     "of N=1024, r=8, p=8 are used. If the secure buffer `out` is given, "
+     "the output is written into it and `out` is returned instead. If "
+     "`threads` is greater than 1, up to that many of the `p` lanes are "
+     "computed at once on the calling thread and the native worker pool. "
+     "The output is the same, but each running lane needs its own "
+     "128 * r * N bytes of memory."
+    },
+    {"scrypt-async", scrypt_async,
+     "(scrypt-async out-len password salt &opt N r p out threads)\n\n"
+     "Like `scrypt`, but the key is derived on the native worker pool while "
+     "the calling fiber yields to the event loop. With `threads` greater "
+     "than 1, the job's worker splits the lanes like `scrypt` does. Raises "
+     "an error right away if the worker pool queue is full."
     },
     {NULL, NULL, NULL}
 };
@@ -0,0 +1,484 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_SECURE_BUFFER_H
+#define BOTAN_SECURE_BUFFER_H
+
+#ifdef JANET_WINDOWS
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Secure memory arena
+ *
+ * Secrets are carved out of 64 KiB chunks which are mapped once, locked
+ * into RAM and excluded from core dumps. Requests of up to a whole chunk
+ * are served from power-of-two size classes (32 .. 65536 bytes) with
+ * intrusive free lists, so allocating and releasing a secret is a list
+ * push/pop under a mutex. Only requests larger than a chunk get pages of
+ * their own, locked and excluded from core dumps the same way, which are
+ * unmapped on release and counted as `:large-allocs`. Memory is always
+ * wiped with botan_scrub_mem before it goes back to the arena. If the
+ * process is not allowed to lock more memory the chunk is still used, but
+ * it is reported as unlocked by `secure-buffer/stats`.
+ */
+
+#define SECURE_ARENA_CHUNK_SIZE (64 * 1024)
+#define SECURE_ARENA_MIN_CLASS  32
+#define SECURE_ARENA_CLASSES    12
+#define SECURE_ARENA_MAX_CLASS  (SECURE_ARENA_MIN_CLASS << (SECURE_ARENA_CLASSES - 1))
+
+#if SECURE_ARENA_MAX_CLASS > SECURE_ARENA_CHUNK_SIZE
+#error "The largest secure arena class must fit in a chunk"
+#endif
+
+typedef struct secure_arena {
+    void *free_list[SECURE_ARENA_CLASSES];
+    uint8_t *chunk;
+    size_t chunk_used;
+    size_t chunks;
+    size_t locked_chunks;
+    size_t large_allocs;
+    size_t bytes_in_use;
+} secure_arena_t;
+
+static secure_arena_t secure_arena;
+
+#ifdef JANET_WINDOWS
+static SRWLOCK secure_arena_lock = SRWLOCK_INIT;
+#define SECURE_ARENA_LOCK()   AcquireSRWLockExclusive(&secure_arena_lock)
+#define SECURE_ARENA_UNLOCK() ReleaseSRWLockExclusive(&secure_arena_lock)
+#else
+static pthread_mutex_t secure_arena_lock = PTHREAD_MUTEX_INITIALIZER;
+#define SECURE_ARENA_LOCK()   pthread_mutex_lock(&secure_arena_lock)
+#define SECURE_ARENA_UNLOCK() pthread_mutex_unlock(&secure_arena_lock)
+#endif
+
+static size_t secure_page_size(void) {
+    static size_t page_size = 0;
+    if (page_size == 0) {
+#ifdef JANET_WINDOWS
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        page_size = info.dwPageSize;
+#else
+        long sz = sysconf(_SC_PAGESIZE);
+        page_size = sz > 0 ? (size_t)sz : 4096;
+#endif
+    }
+    return page_size;
+}
+
+static void *secure_pages_map(size_t size, bool *locked) {
+#ifdef JANET_WINDOWS
+    void *p = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (p == NULL) {
+        return NULL;
+    }
+    *locked = VirtualLock(p, size) != 0;
+#else
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    *locked = mlock(p, size) == 0;
+#ifdef MADV_DONTDUMP
+    madvise(p, size, MADV_DONTDUMP);
+#endif
+#endif
+    return p;
+}
+
+static void secure_pages_unmap(void *p, size_t size) {
+#ifdef JANET_WINDOWS
+    VirtualUnlock(p, size);
+    VirtualFree(p, 0, MEM_RELEASE);
+#else
+    munlock(p, size);
+    munmap(p, size);
+#endif
+}
+
+static int secure_arena_class(size_t size) {
+    int c = 0;
+    size_t class_size = SECURE_ARENA_MIN_CLASS;
+    while (class_size < size) {
+        class_size <<= 1;
+        c++;
+    }
+    return c;
+}
+
+/* Hand the unused tail of the current chunk to the free lists. The bump
+ * pointer only ever advances by class sizes, so the tail is a multiple of
+ * the smallest class. Called with the lock held. */
+static void secure_arena_retire_chunk(void) {
+    if (secure_arena.chunk == NULL) {
+        return;
+    }
+
+    size_t remaining = SECURE_ARENA_CHUNK_SIZE - secure_arena.chunk_used;
+    while (remaining >= SECURE_ARENA_MIN_CLASS) {
+        int c = SECURE_ARENA_CLASSES - 1;
+        while ((size_t)(SECURE_ARENA_MIN_CLASS << c) > remaining) {
+            c--;
+        }
+        size_t class_size = (size_t)SECURE_ARENA_MIN_CLASS << c;
+        void **block = (void **)(secure_arena.chunk + secure_arena.chunk_used);
+        *block = secure_arena.free_list[c];
+        secure_arena.free_list[c] = block;
+        secure_arena.chunk_used += class_size;
+        remaining -= class_size;
+    }
+    secure_arena.chunk = NULL;
+}
+
+/* Returns zeroed memory of at least `size` bytes, or NULL. The usable
+ * size is stored in `capacity` and must be passed back to
+ * secure_arena_free. Does not touch the Janet VM, so it is safe to call
+ * from any thread. */
+static uint8_t *secure_arena_alloc(size_t size, size_t *capacity) {
+    if (size == 0) {
+        size = 1;
+    }
+
+    if (size > SECURE_ARENA_MAX_CLASS) {
+        size_t page = secure_page_size();
+        size_t rounded = (size + page - 1) & ~(page - 1);
+        bool locked;
+        uint8_t *p = secure_pages_map(rounded, &locked);
+        if (p == NULL) {
+            return NULL;
+        }
+        SECURE_ARENA_LOCK();
+        secure_arena.large_allocs++;
+        secure_arena.bytes_in_use += rounded;
+        SECURE_ARENA_UNLOCK();
+        *capacity = rounded;
+        return p;
+    }
+
+    int c = secure_arena_class(size);
+    size_t class_size = (size_t)SECURE_ARENA_MIN_CLASS << c;
+    uint8_t *p = NULL;
+
+    SECURE_ARENA_LOCK();
+    if (secure_arena.free_list[c] != NULL) {
+        void **block = (void **)secure_arena.free_list[c];
+        secure_arena.free_list[c] = *block;
+        *block = NULL;
+        p = (uint8_t *)block;
+    } else {
+        if (secure_arena.chunk == NULL ||
+            secure_arena.chunk_used + class_size > SECURE_ARENA_CHUNK_SIZE) {
+            bool locked;
+            uint8_t *chunk = secure_pages_map(SECURE_ARENA_CHUNK_SIZE, &locked);
+            if (chunk == NULL) {
+                SECURE_ARENA_UNLOCK();
+                return NULL;
+            }
+            secure_arena_retire_chunk();
+            secure_arena.chunk = chunk;
+            secure_arena.chunk_used = 0;
+            secure_arena.chunks++;
+            if (locked) {
+                secure_arena.locked_chunks++;
+            }
+        }
+        p = secure_arena.chunk + secure_arena.chunk_used;
+        secure_arena.chunk_used += class_size;
+    }
+    secure_arena.bytes_in_use += class_size;
+    SECURE_ARENA_UNLOCK();
+
+    *capacity = class_size;
+    return p;
+}
+
+static void secure_arena_free(uint8_t *p, size_t capacity) {
+    if (p == NULL) {
+        return;
+    }
+
+    botan_scrub_mem(p, capacity);
+
+    if (capacity > SECURE_ARENA_MAX_CLASS) {
+        secure_pages_unmap(p, capacity);
+        SECURE_ARENA_LOCK();
+        secure_arena.large_allocs--;
+        secure_arena.bytes_in_use -= capacity;
+        SECURE_ARENA_UNLOCK();
+        return;
+    }
+
+    int c = secure_arena_class(capacity);
+    void **block = (void **)p;
+
+    SECURE_ARENA_LOCK();
+    *block = secure_arena.free_list[c];
+    secure_arena.free_list[c] = block;
+    secure_arena.bytes_in_use -= capacity;
+    SECURE_ARENA_UNLOCK();
+}
+
+typedef struct botan_secure_buffer_obj {
+    uint8_t *data;
+    size_t len;
+    size_t capacity;
+    uint8_t *pending;
+    size_t pending_capacity;
+} botan_secure_buffer_obj_t;
+
+/* Abstract Object functions */
+static int secure_buffer_gc_fn(void *data, size_t len);
+static int secure_buffer_get_fn(void *data, Janet key, Janet *out);
+static void secure_buffer_tostring_fn(void *p, JanetBuffer *buffer);
+static size_t secure_buffer_length_fn(void *p, size_t len);
+static JanetByteView secure_buffer_bytes_fn(void *p, size_t len);
+
+/* Janet functions */
+static Janet secure_buffer_new(int32_t argc, Janet *argv);
+static Janet secure_buffer_wipe(int32_t argc, Janet *argv);
+static Janet secure_buffer_stats(int32_t argc, Janet *argv);
+
+static JanetAbstractType secure_buffer_obj_type = {
+    "botan/secure-buffer",
+    secure_buffer_gc_fn,
+    NULL,   // gcmark
+    secure_buffer_get_fn,
+    NULL,   // put
+    NULL,   // marshal
+    NULL,   // unmarshal
+    secure_buffer_tostring_fn,
+    NULL,   // compare
+    NULL,   // hash
+    NULL,   // next
+    NULL,   // call
+    secure_buffer_length_fn,
+    secure_buffer_bytes_fn,
+};
+
+static JanetMethod secure_buffer_methods[] = {
+    {"wipe", secure_buffer_wipe},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_secure_buffer_obj_type() {
+    return &secure_buffer_obj_type;
+}
+
+/* Abstract Object functions */
+static int secure_buffer_gc_fn(void *data, size_t len) {
+    botan_secure_buffer_obj_t *obj = (botan_secure_buffer_obj_t *)data;
+
+    secure_arena_free(obj->pending, obj->pending_capacity);
+    secure_arena_free(obj->data, obj->capacity);
+    return 0;
+}
+
+static int secure_buffer_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), secure_buffer_methods, out);
+}
+
+static void secure_buffer_tostring_fn(void *p, JanetBuffer *buffer) {
+    botan_secure_buffer_obj_t *obj = (botan_secure_buffer_obj_t *)p;
+
+    janet_formatb(buffer, "[%d bytes]", (int32_t)obj->len);
+}
+
+static size_t secure_buffer_length_fn(void *p, size_t len) {
+    (void)len;
+    return ((botan_secure_buffer_obj_t *)p)->len;
+}
+
+static JanetByteView secure_buffer_bytes_fn(void *p, size_t len) {
+    (void)len;
+    botan_secure_buffer_obj_t *obj = (botan_secure_buffer_obj_t *)p;
+    JanetByteView view;
+    view.bytes = obj->data;
+    view.len = (int32_t)obj->len;
+    return view;
+}
+
+/* Helpers for secret-producing functions
+ *
+ * A function writing into a secure buffer calls secure_buffer_reserve to
+ * get room for `len` bytes, writes the output there, and then calls
+ * secure_buffer_commit with the final length. The output always goes to a
+ * fresh pending block which only replaces the current contents on commit,
+ * so the output buffer may also be passed as one of the inputs, and a
+ * failing operation leaves the previous contents untouched. */
+static uint8_t *secure_buffer_try_reserve(botan_secure_buffer_obj_t *obj, size_t len) {
+    if (obj->pending != NULL && len <= obj->pending_capacity) {
+        return obj->pending;
+    }
+
+    secure_arena_free(obj->pending, obj->pending_capacity);
+    obj->pending = secure_arena_alloc(len, &obj->pending_capacity);
+    if (obj->pending == NULL) {
+        obj->pending_capacity = 0;
+    }
+    return obj->pending;
+}
+
+static uint8_t *secure_buffer_reserve(botan_secure_buffer_obj_t *obj, size_t len) {
+    uint8_t *p = secure_buffer_try_reserve(obj, len);
+    if (p == NULL) {
+        janet_panic("Failed to allocate secure memory");
+    }
+    return p;
+}
+
+static void secure_buffer_commit(botan_secure_buffer_obj_t *obj, size_t len) {
+    secure_arena_free(obj->data, obj->capacity);
+    obj->data = obj->pending;
+    obj->capacity = obj->pending_capacity;
+    obj->pending = NULL;
+    obj->pending_capacity = 0;
+    obj->len = len;
+}
+
+/* Replace the storage of `obj` with a block obtained from
+ * secure_arena_alloc, e.g. one filled in by a worker thread. */
+static void secure_buffer_adopt(botan_secure_buffer_obj_t *obj, uint8_t *data,
+                                size_t capacity, size_t len) {
+    secure_arena_free(obj->pending, obj->pending_capacity);
+    secure_arena_free(obj->data, obj->capacity);
+    obj->data = data;
+    obj->capacity = capacity;
+    obj->len = len;
+    obj->pending = NULL;
+    obj->pending_capacity = 0;
+}
+
+/* NUL terminated copy of `bytes` in secure memory, for handing secrets
+ * such as passwords to another thread. Returns NULL if the arena is
+ * exhausted. */
+static uint8_t *secure_arena_try_dup(JanetByteView bytes, size_t *capacity) {
+    uint8_t *p = secure_arena_alloc((size_t)bytes.len + 1, capacity);
+    if (p == NULL) {
+        return NULL;
+    }
+    memcpy(p, bytes.bytes, bytes.len);
+    p[bytes.len] = 0;
+    return p;
+}
+
+static uint8_t *secure_arena_dup(JanetByteView bytes, size_t *capacity) {
+    uint8_t *p = secure_arena_try_dup(bytes, capacity);
+    if (p == NULL) {
+        janet_panic("Failed to allocate secure memory");
+    }
+    return p;
+}
+
+static botan_secure_buffer_obj_t *secure_buffer_optout(const Janet *argv, int32_t argc, int32_t n) {
+    return janet_optabstract(argv, argc, n, get_secure_buffer_obj_type(), NULL);
+}
+
+static int view_secure_func(botan_view_ctx view_ctx, const uint8_t *bin, size_t len) {
+    if (!view_ctx || !bin) {
+        return BOTAN_FFI_ERROR_NULL_POINTER;
+    }
+
+    botan_secure_buffer_obj_t *obj = (botan_secure_buffer_obj_t *)view_ctx;
+    uint8_t *out = secure_buffer_try_reserve(obj, len);
+    if (out == NULL) {
+        return BOTAN_FFI_ERROR_OUT_OF_MEMORY;
+    }
+    memcpy(out, bin, len);
+    secure_buffer_commit(obj, len);
+
+    return 0;
+}
+
+/* Janet functions */
+static Janet secure_buffer_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 0, 1);
+    size_t capacity = janet_optsize(argv, argc, 0, 0);
+
+    botan_secure_buffer_obj_t *obj = janet_abstract(&secure_buffer_obj_type, sizeof(botan_secure_buffer_obj_t));
+    memset(obj, 0, sizeof(botan_secure_buffer_obj_t));
+
+    if (capacity > 0) {
+        secure_buffer_reserve(obj, capacity);
+        secure_buffer_commit(obj, 0);
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet secure_buffer_wipe(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 1);
+    botan_secure_buffer_obj_t *obj = janet_getabstract(argv, 0, get_secure_buffer_obj_type());
+
+    if (obj->data != NULL) {
+        botan_scrub_mem(obj->data, obj->capacity);
+    }
+    obj->len = 0;
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet secure_buffer_stats(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 0);
+
+    SECURE_ARENA_LOCK();
+    secure_arena_t arena = secure_arena;
+    SECURE_ARENA_UNLOCK();
+
+    JanetKV *st = janet_struct_begin(4);
+    janet_struct_put(st, janet_ckeywordv("chunks"), janet_wrap_number((double)arena.chunks));
+    janet_struct_put(st, janet_ckeywordv("locked-chunks"), janet_wrap_number((double)arena.locked_chunks));
+    janet_struct_put(st, janet_ckeywordv("large-allocs"), janet_wrap_number((double)arena.large_allocs));
+    janet_struct_put(st, janet_ckeywordv("bytes-in-use"), janet_wrap_number((double)arena.bytes_in_use));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+static JanetReg secure_buffer_cfuns[] = {
+    {"secure-buffer/new", secure_buffer_new,
+     "(secure-buffer/new &opt capacity)\n\n"
+     "Create an empty secure buffer for secret values, optionally with room "
+     "for `capacity` bytes. The memory comes from a locked arena which is "
+     "kept out of swap and core dumps where the platform allows it, and it "
+     "is wiped when the buffer is wiped, shrunk, grown or collected. Pass "
+     "the buffer as the `out` argument of functions such as `kdf`, `pbkdf` "
+     "or `privkey/to-raw` to receive their output without creating an "
+     "immutable string. A secure buffer can be used wherever a byte "
+     "sequence is expected."
+    },
+    {"secure-buffer/wipe", secure_buffer_wipe,
+     "(secure-buffer/wipe secure-buffer)\n\n"
+     "Overwrite the contents of `secure-buffer` with zeros and set its "
+     "length to 0. The memory is kept for reuse. Returns `secure-buffer`."
+    },
+    {"secure-buffer/stats", secure_buffer_stats,
+     "(secure-buffer/stats)\n\n"
+     "Returns a struct describing the secure memory arena: the number of "
+     "`:chunks` mapped, how many of them are `:locked-chunks`, the number "
+     "of `:large-allocs` larger than a chunk and served outside of them, "
+     "and `:bytes-in-use`."
+    },
+    {NULL, NULL, NULL}
+};
+
+static void submod_secure_buffer(JanetTable *env) {
+    janet_cfuns(env, "botan", secure_buffer_cfuns);
+    janet_register_abstract_type(get_secure_buffer_obj_type());
+}
+
+#endif /* BOTAN_SECURE_BUFFER_H */
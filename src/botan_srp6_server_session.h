@@ -111,15 +111,30 @@ static Janet srp6_server_session_step1(int32_t argc, Janet *argv) {
 }
 
 static Janet srp6_server_session_step2(int32_t argc, Janet *argv) {
-    janet_fixarity(argc, 2);
+    janet_arity(argc, 2, 3);
 
     botan_srp6_server_session_obj_t *obj = janet_getabstract(argv, 0, get_srp6_server_session_obj_type());
     botan_srp6_server_session_t srp6 = obj->srp6_server_session;
     JanetByteView A = janet_getbytes(argv, 1);
-    JanetBuffer *K = janet_buffer(obj->group_size);
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 2);
     size_t K_len = obj->group_size;
+    int ret;
+
+    if (secure_out) {
+        uint8_t *K = secure_buffer_reserve(secure_out, K_len);
+        ret = botan_srp6_server_session_step2(srp6, A.bytes, A.len, K, &K_len);
+        if (ret == BOTAN_FFI_ERROR_INSUFFICIENT_BUFFER_SPACE) {
+            K = secure_buffer_reserve(secure_out, K_len);
+            ret = botan_srp6_server_session_step2(srp6, A.bytes, A.len, K, &K_len);
+        }
+        JANET_BOTAN_ASSERT(ret);
+
+        secure_buffer_commit(secure_out, K_len);
+        return janet_wrap_abstract(secure_out);
+    }
 
-    int ret = botan_srp6_server_session_step2(srp6, A.bytes, A.len, K->data, &K_len);
+    JanetBuffer *K = janet_buffer(obj->group_size);
+    ret = botan_srp6_server_session_step2(srp6, A.bytes, A.len, K->data, &K_len);
     if (!ret) {
         return janet_wrap_string(janet_string(K->data, K_len));
     } else if (ret && ret != BOTAN_FFI_ERROR_INSUFFICIENT_BUFFER_SPACE) {
@@ -168,7 +183,7 @@ static Janet srp6_generate_verifier(int32_t argc, Janet *argv) {
 }
 
 static Janet srp6_client_agree(int32_t argc, Janet *argv) {
-    janet_arity(argc, 6, 7);
+    janet_arity(argc, 6, 8);
 
     int ret;
     const char *username = janet_getcstring(argv, 0);
@@ -190,11 +205,13 @@ static Janet srp6_client_agree(int32_t argc, Janet *argv) {
         rng = obj2->rng;
     }
 
+    botan_secure_buffer_obj_t *secure_out = secure_buffer_optout(argv, argc, 7);
+
     size_t size = 0;
     ret = botan_srp6_group_size(group, &size);
 
     JanetBuffer *A = janet_buffer(size);
-    JanetBuffer *K = janet_buffer(size);
+    JanetBuffer *K = secure_out ? NULL : janet_buffer(size);
     size_t A_len = size;
     size_t K_len = size;
 
@@ -203,14 +220,15 @@ static Janet srp6_client_agree(int32_t argc, Janet *argv) {
                                   B.bytes, B.len,
                                   rng,
                                   A->data, &A_len,
-                                  K->data, &K_len);
+                                  secure_out ? secure_buffer_reserve(secure_out, K_len) : K->data,
+                                  &K_len);
      if (ret && ret != BOTAN_FFI_ERROR_INSUFFICIENT_BUFFER_SPACE) {
          JANET_BOTAN_ASSERT(ret);
      } else if (ret == BOTAN_FFI_ERROR_INSUFFICIENT_BUFFER_SPACE) {
          if (A_len > size) {
              A = janet_buffer(A_len);
          }
-         if (K_len > size) {
+         if (!secure_out && K_len > size) {
              K = janet_buffer(K_len);
          }
          ret = botan_srp6_client_agree(username, password, group, hash,
@@ -218,13 +236,22 @@ static Janet srp6_client_agree(int32_t argc, Janet *argv) {
                                        B.bytes, B.len,
                                        rng,
                                        A->data, &A_len,
-                                       K->data, &K_len);
+                                       secure_out ? secure_buffer_reserve(secure_out, K_len) : K->data,
+                                       &K_len);
          JANET_BOTAN_ASSERT(ret);
      }
 
+     Janet shared_key;
+     if (secure_out) {
+         secure_buffer_commit(secure_out, K_len);
+         shared_key = janet_wrap_abstract(secure_out);
+     } else {
+         shared_key = janet_wrap_string(janet_string(K->data, K_len));
+     }
+
      Janet result[2] = {
          janet_wrap_string(janet_string(A->data, A_len)),
-         janet_wrap_string(janet_string(K->data, K_len)),
+         shared_key,
      };
      return janet_wrap_tuple(janet_tuple_n(result, 2));
 }
@@ -240,9 +267,10 @@ static JanetReg srp6_server_session_cfuns[] = {
      "group-id, and output a value B which is provided to the client."
     },
     {"srp6-server-session/step2", srp6_server_session_step2,
-     "(srp6-server-session/step2 srp6-obj A)\n\n"
+     "(srp6-server-session/step2 srp6-obj A &opt out)\n\n"
      "Takes the parameter A generated by srp6-client-agree, and return the "
-     "shared secret key.\n\n"
+     "shared secret key. If the secure buffer `out` is given, the key is "
+     "written into it and `out` is returned instead.\n\n"
      "In the event of an impersonation attack (or wrong username/password, "
      "etc) no error occurs, but the key returned will be different on the two "
      "sides. The two sides must verify each other, for example by using the "
@@ -256,13 +284,14 @@ static JanetReg srp6_server_session_cfuns[] = {
      "client during the key agreement step."
     },
     {"srp6-client-agree", srp6_client_agree,
-     "(srp6-client-agree username password group-id hash salt B &opt rng)\n\n"
+     "(srp6-client-agree username password group-id hash salt B &opt rng out)\n\n"
      "The client receives these parameters from the server, except for the "
      "`username` and `password` which are provided by the user. The parameter "
      "B is the output of step1.\n\n"
      "The client agreement step outputs a shared symmetric key along with the "
      "parameter A which is returned to the server (and allows it the compute "
-     "the shared key)."
+     "the shared key). If the secure buffer `out` is given, the shared key "
+     "is written into it and `out` takes its place in the result."
     },
     {NULL, NULL, NULL}
 };
@@ -9,16 +9,71 @@
 
 typedef struct botan_totp_obj {
     botan_totp_t totp;
+    uint32_t modulus;
+    uint64_t timestep;
 } botan_totp_obj_t;
 
+/*
+ * TOTP verifier
+ *
+ * Keeps the HMAC keyed with the secret, so that the key schedule is done
+ * once, and the codes of the acceptable window for the current time step,
+ * so that checking a code in the same step needs no HMAC at all. As with
+ * `totp/check`, the window is the current step and `drift` steps back.
+ */
+typedef struct botan_totp_verifier_obj {
+    botan_mac_t mac;
+    size_t mac_len;
+    uint32_t modulus;
+    uint64_t timestep;
+    size_t drift;
+    uint64_t window_step;
+    bool window_valid;
+    uint32_t *window;
+} botan_totp_verifier_obj_t;
+
+/*
+ * TOTP replay index
+ *
+ * Remembers the last accepted time step per user so that a code cannot
+ * be used twice, and no code older than the last accepted one is taken
+ * either (RFC 6238, section 5.2). Users are identified by a SipHash of
+ * their id under a random key. Entries live in a table with short linear
+ * probing. An entry can be reused once its step falls outside the largest
+ * drift the index was used with. When a probe run is full the table is
+ * doubled, and if it cannot grow any more the code is rejected: a
+ * remembered user is never dropped while a code could still be replayed.
+ */
+#define TOTP_REPLAY_PROBES    16
+#define TOTP_REPLAY_MAX_SLOTS (1 << 24)
+
+typedef struct totp_replay_slot {
+    uint64_t user;
+    uint64_t step;
+} totp_replay_slot_t;
+
+typedef struct botan_totp_replay_obj {
+    botan_mac_t siphash;
+    size_t mask;
+    size_t max_drift;
+    totp_replay_slot_t *slots;
+} botan_totp_replay_obj_t;
+
 /* Abstract Object functions */
 static int totp_gc_fn(void *data, size_t len);
 static int totp_get_fn(void *data, Janet key, Janet *out);
+static int totp_verifier_gc_fn(void *data, size_t len);
+static int totp_verifier_get_fn(void *data, Janet key, Janet *out);
+static int totp_replay_gc_fn(void *data, size_t len);
 
 /* Janet functions */
 static Janet totp_new(int32_t argc, Janet *argv);
 static Janet totp_generate(int32_t argc, Janet *argv);
 static Janet totp_check(int32_t argc, Janet *argv);
+static Janet totp_verifier_new(int32_t argc, Janet *argv);
+static Janet totp_verifier_check(int32_t argc, Janet *argv);
+static Janet totp_check_many(int32_t argc, Janet *argv);
+static Janet totp_replay_index_new(int32_t argc, Janet *argv);
 
 static JanetAbstractType totp_obj_type = {
     "botan/totp",
@@ -34,10 +89,37 @@ static JanetMethod totp_methods[] = {
     {NULL, NULL},
 };
 
+static JanetAbstractType totp_verifier_obj_type = {
+    "botan/totp-verifier",
+    totp_verifier_gc_fn,
+    NULL,
+    totp_verifier_get_fn,
+    JANET_ATEND_GET
+};
+
+static JanetMethod totp_verifier_methods[] = {
+    {"check", totp_verifier_check},
+    {NULL, NULL},
+};
+
+static JanetAbstractType totp_replay_obj_type = {
+    "botan/totp-replay-index",
+    totp_replay_gc_fn,
+    JANET_ATEND_GC
+};
+
 static JanetAbstractType *get_totp_obj_type() {
     return &totp_obj_type;
 }
 
+static JanetAbstractType *get_totp_verifier_obj_type() {
+    return &totp_verifier_obj_type;
+}
+
+static JanetAbstractType *get_totp_replay_obj_type() {
+    return &totp_replay_obj_type;
+}
+
 /* Abstract Object functions */
 static int totp_gc_fn(void *data, size_t len) {
     botan_totp_obj_t *obj = (botan_totp_obj_t *)data;
@@ -57,6 +139,249 @@ static int totp_get_fn(void *data, Janet key, Janet *out) {
     return janet_getmethod(janet_unwrap_keyword(key), totp_methods, out);
 }
 
+static int totp_verifier_gc_fn(void *data, size_t len) {
+    botan_totp_verifier_obj_t *obj = (botan_totp_verifier_obj_t *)data;
+
+    if (obj->window) {
+        botan_scrub_mem(obj->window, sizeof(uint32_t) * (obj->drift + 1));
+        janet_free(obj->window);
+    }
+    if (obj->mac) {
+        int ret = botan_mac_destroy(obj->mac);
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return 0;
+}
+
+static int totp_verifier_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), totp_verifier_methods, out);
+}
+
+static int totp_replay_gc_fn(void *data, size_t len) {
+    botan_totp_replay_obj_t *obj = (botan_totp_replay_obj_t *)data;
+
+    janet_free(obj->slots);
+    if (obj->siphash) {
+        int ret = botan_mac_destroy(obj->siphash);
+        JANET_BOTAN_ASSERT(ret);
+    }
+
+    return 0;
+}
+
+/* TOTP verifier helpers */
+
+/* Marks a window slot whose step would be before the epoch. No code is
+ * ever this large. */
+#define TOTP_NO_CODE UINT32_MAX
+
+/* The HOTP value of `counter` (RFC 4226 dynamic truncation). */
+static int totp_verifier_code(botan_totp_verifier_obj_t *obj, uint64_t counter, uint32_t *code) {
+    uint8_t msg[8];
+    uint8_t mac[64];
+
+    for (int i = 0; i < 8; i++) {
+        msg[i] = (uint8_t)(counter >> (56 - 8 * i));
+    }
+
+    int ret = botan_mac_update(obj->mac, msg, sizeof(msg));
+    if (ret == 0) {
+        ret = botan_mac_final(obj->mac, mac);
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    size_t offset = mac[obj->mac_len - 1] & 0x0F;
+    uint32_t bin = ((uint32_t)(mac[offset] & 0x7F) << 24) |
+                   ((uint32_t)mac[offset + 1] << 16) |
+                   ((uint32_t)mac[offset + 2] << 8) |
+                   (uint32_t)mac[offset + 3];
+    *code = bin % obj->modulus;
+    botan_scrub_mem(mac, sizeof(mac));
+    return 0;
+}
+
+/* Brings the window up to date for `timestamp`. */
+static int totp_verifier_update(botan_totp_verifier_obj_t *obj, uint64_t timestamp) {
+    uint64_t step = timestamp / obj->timestep;
+    if (obj->window_valid && obj->window_step == step) {
+        return 0;
+    }
+
+    obj->window_valid = false;
+    for (size_t i = 0; i <= obj->drift; i++) {
+        if (i > step) {
+            obj->window[i] = TOTP_NO_CODE;
+            continue;
+        }
+        int ret = totp_verifier_code(obj, step - i, &obj->window[i]);
+        if (ret != 0) {
+            return ret;
+        }
+    }
+    obj->window_step = step;
+    obj->window_valid = true;
+    return 0;
+}
+
+/* Compares `code` with every code of the window, without stopping at
+ * the first match. On a match, `back` is set to how many steps before the
+ * current one the code belongs to. */
+static bool totp_verifier_match(botan_totp_verifier_obj_t *obj, uint32_t code, size_t *back) {
+    uint32_t found = 0;
+    size_t matched = 0;
+    for (size_t i = 0; i <= obj->drift; i++) {
+        uint32_t diff = obj->window[i] ^ code;
+        uint32_t hit = ((diff | (0 - diff)) >> 31) ^ 1;
+        matched |= (size_t)(0 - (hit & (found ^ 1))) & i;
+        found |= hit;
+    }
+    *back = matched;
+    return found != 0;
+}
+
+/* TOTP replay index helpers */
+
+static int totp_replay_user(botan_totp_replay_obj_t *obj, JanetByteView user_id, uint64_t *user) {
+    uint8_t tag[8];
+    int ret = botan_mac_update(obj->siphash, user_id.bytes, user_id.len);
+    if (ret == 0) {
+        ret = botan_mac_final(obj->siphash, tag);
+    }
+    if (ret != 0) {
+        return ret;
+    }
+
+    uint64_t h = 0;
+    for (int i = 0; i < 8; i++) {
+        h = (h << 8) | tag[i];
+    }
+    *user = h ? h : 1;
+    return 0;
+}
+
+static bool totp_replay_live(botan_totp_replay_obj_t *obj, totp_replay_slot_t *slot,
+                             uint64_t current_step) {
+    return slot->user != 0 && slot->step + obj->max_drift >= current_step;
+}
+
+static size_t totp_replay_probes(size_t mask) {
+    return mask + 1 < TOTP_REPLAY_PROBES ? mask + 1 : TOTP_REPLAY_PROBES;
+}
+
+/* Doubles the table, keeping the live entries, until all of them fit.
+ * Returns false if the table is already at its largest or memory runs
+ * out, in which case it is left as it was. */
+static bool totp_replay_grow(botan_totp_replay_obj_t *obj, uint64_t current_step) {
+    size_t slots = obj->mask + 1;
+
+    while (slots < TOTP_REPLAY_MAX_SLOTS) {
+        slots <<= 1;
+        size_t mask = slots - 1;
+        size_t probes = totp_replay_probes(mask);
+        totp_replay_slot_t *table = janet_calloc(slots, sizeof(totp_replay_slot_t));
+        if (table == NULL) {
+            return false;
+        }
+
+        bool placed_all = true;
+        for (size_t i = 0; i <= obj->mask && placed_all; i++) {
+            totp_replay_slot_t *old = &obj->slots[i];
+            if (!totp_replay_live(obj, old, current_step)) {
+                continue;
+            }
+            placed_all = false;
+            for (size_t k = 0; k < probes; k++) {
+                totp_replay_slot_t *slot = &table[(old->user + k) & mask];
+                if (slot->user == 0) {
+                    *slot = *old;
+                    placed_all = true;
+                    break;
+                }
+            }
+        }
+
+        if (placed_all) {
+            janet_free(obj->slots);
+            obj->slots = table;
+            obj->mask = mask;
+            return true;
+        }
+        janet_free(table);
+    }
+    return false;
+}
+
+/* Records that `user` used the code of `step`. Returns false if a code of
+ * that step or a later one was already accepted for the user, or if the
+ * index is full. */
+static bool totp_replay_accept(botan_totp_replay_obj_t *obj, uint64_t user,
+                               uint64_t step, uint64_t current_step, size_t drift) {
+    if (drift > obj->max_drift) {
+        obj->max_drift = drift;
+    }
+
+    for (;;) {
+        size_t probes = totp_replay_probes(obj->mask);
+        totp_replay_slot_t *free_slot = NULL;
+
+        for (size_t k = 0; k < probes; k++) {
+            totp_replay_slot_t *slot = &obj->slots[(user + k) & obj->mask];
+            if (slot->user == user) {
+                if (step <= slot->step) {
+                    return false;
+                }
+                slot->step = step;
+                return true;
+            }
+            if (free_slot == NULL && !totp_replay_live(obj, slot, current_step)) {
+                free_slot = slot;
+            }
+        }
+
+        if (free_slot != NULL) {
+            free_slot->user = user;
+            free_slot->step = step;
+            return true;
+        }
+        if (!totp_replay_grow(obj, current_step)) {
+            return false;
+        }
+    }
+}
+
+/* Reads the optional `replay-index user-id` pair at `n`. */
+static botan_totp_replay_obj_t *totp_opt_replay(const Janet *argv, int32_t argc, int32_t n,
+                                                uint64_t *user) {
+    if (argc <= n || janet_checktype(argv[n], JANET_NIL)) {
+        return NULL;
+    }
+
+    botan_totp_replay_obj_t *obj = janet_getabstract(argv, n, get_totp_replay_obj_type());
+    if (argc <= n + 1) {
+        janet_panic("user-id is required with a replay index");
+    }
+    JanetByteView user_id = janet_getbytes(argv, n + 1);
+
+    int ret = totp_replay_user(obj, user_id, user);
+    JANET_BOTAN_ASSERT(ret);
+    return obj;
+}
+
+static uint64_t totp_opt_timestamp(const Janet *argv, int32_t argc, int32_t n) {
+    if (argc > n && !janet_checktype(argv[n], JANET_NIL)) {
+        return janet_getuinteger64(argv, n);
+    }
+    return (uint64_t)time(NULL);
+}
+
 /* Janet functions */
 static Janet totp_new(int32_t argc, Janet *argv) {
     janet_arity(argc, 1, 4);
@@ -73,6 +398,9 @@ static Janet totp_new(int32_t argc, Janet *argv) {
     int ret = botan_totp_init(&obj->totp, key.bytes, key.len, hash, digits, timestep);
     JANET_BOTAN_ASSERT(ret);
 
+    obj->modulus = hotp_modulus(digits);
+    obj->timestep = timestep;
+
     return janet_wrap_abstract(obj);
 }
 
@@ -95,23 +423,212 @@ static Janet totp_generate(int32_t argc, Janet *argv) {
 }
 
 static Janet totp_check(int32_t argc, Janet *argv) {
-    janet_arity(argc, 2, 4);
+    janet_arity(argc, 2, 6);
 
     botan_totp_obj_t *obj = janet_getabstract(argv, 0, get_totp_obj_type());
     botan_totp_t totp = obj->totp;
-    uint32_t code = (uint32_t)janet_getsize(argv, 1);
+    uint32_t code;
+    bool in_range = hotp_getcode(argv, 1, obj->modulus, &code);
+    uint64_t timestamp = totp_opt_timestamp(argv, argc, 2);
+    size_t acceptable_drift = janet_optsize(argv, argc, 3, 0);
+    uint64_t user;
+    botan_totp_replay_obj_t *replay = totp_opt_replay(argv, argc, 4, &user);
 
-    uint64_t timestamp = (uint64_t)time(NULL);
-    if (argc >= 3) {
-        timestamp = janet_getuinteger64(argv, 2);
+    if (!in_range) {
+        return janet_wrap_boolean(false);
     }
+    if (replay == NULL) {
+        int ret = botan_totp_check(totp, code, timestamp, acceptable_drift);
+        JANET_BOTAN_ASSERT(ret);
 
-    size_t acceptable_drift = janet_optsize(argv, argc, 3, 0);
+        return janet_wrap_boolean(ret == 0);
+    }
+
+    /* Find the step the code belongs to, then record it. */
+    uint64_t step = timestamp / obj->timestep;
+    for (size_t i = 0; i <= acceptable_drift && i <= step; i++) {
+        int ret = botan_totp_check(totp, code, (step - i) * obj->timestep, 0);
+        JANET_BOTAN_ASSERT(ret);
 
-    int ret = botan_totp_check(totp, code, timestamp, acceptable_drift);
+        if (ret == 0) {
+            return janet_wrap_boolean(totp_replay_accept(replay, user, step - i, step, acceptable_drift));
+        }
+    }
+
+    return janet_wrap_boolean(false);
+}
+
+static Janet totp_verifier_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 5);
+
+    botan_totp_verifier_obj_t *obj = janet_abstract(&totp_verifier_obj_type, sizeof(botan_totp_verifier_obj_t));
+    memset(obj, 0, sizeof(botan_totp_verifier_obj_t));
+
+    JanetByteView key = janet_getbytes(argv, 0);
+
+    const char *hash = janet_optcstring(argv, argc, 1, "SHA-1");
+    size_t digits = janet_optsize(argv, argc, 2, 6);
+    size_t timestep = janet_optsize(argv, argc, 3, 30);
+    size_t drift = janet_optsize(argv, argc, 4, 0);
+    char mac_name[HKDF_MAC_NAME_LEN];
+
+    if (digits < 6 || digits > 8) {
+        janet_panic("digits must be 6, 7 or 8");
+    }
+    if (timestep == 0) {
+        janet_panic("timestep must be positive");
+    }
+    if (drift > 1024) {
+        janet_panic("acceptable-drift is too large");
+    }
+    /* RFC 6238 only defines these; the dynamic truncation also relies on
+     * the MAC being at least 20 bytes. */
+    if (strcmp(hash, "SHA-1") != 0 && strcmp(hash, "SHA-256") != 0 &&
+        strcmp(hash, "SHA-512") != 0) {
+        janet_panicf("Unsupported hash for TOTP: %s", hash);
+    }
+    snprintf(mac_name, sizeof(mac_name), "HMAC(%s)", hash);
+
+    int ret = botan_mac_init(&obj->mac, mac_name, 0);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_mac_output_length(obj->mac, &obj->mac_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_mac_set_key(obj->mac, key.bytes, key.len);
     JANET_BOTAN_ASSERT(ret);
 
-    return janet_wrap_boolean(ret == 0);
+    obj->modulus = hotp_modulus(digits);
+    obj->timestep = timestep;
+    obj->drift = drift;
+    obj->window = janet_malloc(sizeof(uint32_t) * (drift + 1));
+    if (obj->window == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+static Janet totp_verifier_check(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 5);
+
+    botan_totp_verifier_obj_t *obj = janet_getabstract(argv, 0, get_totp_verifier_obj_type());
+    uint32_t code;
+    bool in_range = hotp_getcode(argv, 1, obj->modulus, &code);
+    uint64_t timestamp = totp_opt_timestamp(argv, argc, 2);
+    uint64_t user;
+    botan_totp_replay_obj_t *replay = totp_opt_replay(argv, argc, 3, &user);
+    size_t back;
+
+    if (!in_range) {
+        return janet_wrap_boolean(false);
+    }
+
+    int ret = totp_verifier_update(obj, timestamp);
+    JANET_BOTAN_ASSERT(ret);
+
+    if (!totp_verifier_match(obj, code, &back)) {
+        return janet_wrap_boolean(false);
+    }
+    if (replay == NULL) {
+        return janet_wrap_boolean(true);
+    }
+
+    uint64_t step = obj->window_step;
+    return janet_wrap_boolean(totp_replay_accept(replay, user, step - back, step, obj->drift));
+}
+
+static Janet totp_check_many(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 3);
+
+    JanetView items = janet_getindexed(argv, 0);
+    uint64_t timestamp = totp_opt_timestamp(argv, argc, 1);
+    size_t acceptable_drift = janet_optsize(argv, argc, 2, 0);
+
+    /* Validate everything first so that a bad entry fails the whole call
+     * before any work is done. */
+    for (int32_t i = 0; i < items.len; i++) {
+        const Janet *pair;
+        int32_t pair_len;
+        if (!janet_indexed_view(items.items[i], &pair, &pair_len) || pair_len != 2 ||
+            !janet_checksize(pair[1]) ||
+            (!janet_checkabstract(pair[0], get_totp_obj_type()) &&
+             !janet_checkabstract(pair[0], get_totp_verifier_obj_type()))) {
+            janet_panicf("expected [totp code] pair at index %d, got %v", i, items.items[i]);
+        }
+    }
+
+    JanetArray *results = janet_array(items.len);
+    for (int32_t i = 0; i < items.len; i++) {
+        const Janet *pair;
+        int32_t pair_len;
+        janet_indexed_view(items.items[i], &pair, &pair_len);
+        uint32_t code;
+        bool valid;
+
+        if (janet_checkabstract(pair[0], get_totp_verifier_obj_type())) {
+            botan_totp_verifier_obj_t *obj = janet_unwrap_abstract(pair[0]);
+            valid = hotp_getcode(pair, 1, obj->modulus, &code);
+            if (valid) {
+                int ret = totp_verifier_update(obj, timestamp);
+                JANET_BOTAN_ASSERT(ret);
+                size_t back;
+                valid = totp_verifier_match(obj, code, &back);
+            }
+        } else {
+            botan_totp_obj_t *obj = janet_unwrap_abstract(pair[0]);
+            valid = hotp_getcode(pair, 1, obj->modulus, &code);
+            if (valid) {
+                int ret = botan_totp_check(obj->totp, code, timestamp, acceptable_drift);
+                JANET_BOTAN_ASSERT(ret);
+                valid = ret == 0;
+            }
+        }
+        janet_array_push(results, janet_wrap_boolean(valid));
+    }
+
+    return janet_wrap_array(results);
+}
+
+static Janet totp_replay_index_new(int32_t argc, Janet *argv) {
+    janet_arity(argc, 0, 1);
+    size_t capacity = janet_optsize(argv, argc, 0, 4096);
+    uint8_t key[16];
+    botan_rng_t rng;
+
+    if (capacity == 0 || capacity > TOTP_REPLAY_MAX_SLOTS) {
+        janet_panic("capacity must be between 1 and 16777216");
+    }
+    size_t slots = 1;
+    while (slots < capacity) {
+        slots <<= 1;
+    }
+
+    botan_totp_replay_obj_t *obj = janet_abstract(&totp_replay_obj_type, sizeof(botan_totp_replay_obj_t));
+    memset(obj, 0, sizeof(botan_totp_replay_obj_t));
+
+    int ret = botan_mac_init(&obj->siphash, "SipHash(2,4)", 0);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_rng_init(&rng, "system");
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_rng_get(rng, key, sizeof(key));
+    botan_rng_destroy(rng);
+    JANET_BOTAN_ASSERT(ret);
+
+    ret = botan_mac_set_key(obj->siphash, key, sizeof(key));
+    botan_scrub_mem(key, sizeof(key));
+    JANET_BOTAN_ASSERT(ret);
+
+    obj->slots = janet_malloc(sizeof(totp_replay_slot_t) * slots);
+    if (obj->slots == NULL) {
+        JANET_OUT_OF_MEMORY;
+    }
+    memset(obj->slots, 0, sizeof(totp_replay_slot_t) * slots);
+    obj->mask = slots - 1;
+
+    return janet_wrap_abstract(obj);
 }
 
 static JanetReg totp_cfuns[] = {
@@ -128,12 +645,49 @@ static JanetReg totp_cfuns[] = {
      "timestamp is used."
     },
     {"totp/check", totp_check,
-     "(totp/check totp-obj code &opt timestamp acceptable-drift)\n\n"
+     "(totp/check totp-obj code &opt timestamp acceptable-drift replay-index user-id)\n\n"
      "Return true if the provided OTP `code` is correct for the provided "
      "`timestamp`. If required, use clock `acceptable-drift` to deal with the "
      "client and server having slightly different clocks. If omitted, current "
      "timestamp is used for `timestamp` and the default value for "
-     "`acceptable-drift` is 0."
+     "`acceptable-drift` is 0. If a `replay-index` and the bytes `user-id` "
+     "are given, a code is also rejected when `user-id` already used it, or "
+     "a code of a later time step, and an accepted code is recorded in the "
+     "same step."
+    },
+    {"totp/verifier", totp_verifier_new,
+     "(totp/verifier key &opt hash digits timestep acceptable-drift)\n\n"
+     "Create a verifier for one TOTP secret. `hash` must be one of the "
+     "RFC 6238 hashes \"SHA-1\", \"SHA-256\" and \"SHA-512\". The "
+     "verifier keys the HMAC once and keeps the codes of the current time step and the `acceptable-drift` "
+     "steps before it, so repeated checks in the same step cost no HMAC "
+     "computation. Defaults are the same as for `totp/new`, with an "
+     "`acceptable-drift` of 0. Returns `totp-verifier-obj`."
+    },
+    {"totp-verifier/check", totp_verifier_check,
+     "(totp-verifier/check totp-verifier-obj code &opt timestamp replay-index user-id)\n\n"
+     "Return true if `code` is correct for `timestamp` within the drift of "
+     "the verifier, like `totp/check`. If omitted, current timestamp is "
+     "used. `replay-index` and `user-id` work as for `totp/check`."
+    },
+    {"totp/replay-index", totp_replay_index_new,
+     "(totp/replay-index &opt capacity)\n\n"
+     "Create an index of the last time step each user logged in with, to "
+     "be passed to `totp/check` and `totp-verifier/check`. It takes 16 "
+     "bytes per user and is sized for `capacity` users (default 4096) "
+     "whose codes are still within the acceptable drift. It grows when "
+     "more users need to be remembered; if it cannot, codes of new users "
+     "are rejected rather than forgetting anyone. Users are identified by "
+     "a keyed hash of their id. Returns `totp-replay-index-obj`."
+    },
+    {"totp/check-many", totp_check_many,
+     "(totp/check-many items &opt timestamp acceptable-drift)\n\n"
+     "Check many codes at once. `items` is an indexed collection of "
+     "`[totp code]` pairs, where `totp` is a `totp-obj` or a "
+     "`totp-verifier-obj`. All codes are checked against the same "
+     "`timestamp` (current timestamp if omitted). `acceptable-drift` "
+     "applies to `totp-obj` entries; verifiers use their own. Returns an "
+     "array of booleans in the order of `items`."
     },
 
     {NULL, NULL, NULL}
@@ -7,75 +7,474 @@
 #ifndef BOTAN_UTILITY_H
 #define BOTAN_UTILITY_H
 
+/* Output buffer helpers */
+
+/* Make room for `n` more bytes at the end of `buf` and return a pointer
+ * to them, for functions appending their output to a caller's buffer. If
+ * `in` points into `buf` itself, it is re-pointed after a possible
+ * reallocation. */
+static uint8_t *buffer_reserve_out(JanetBuffer *buf, size_t n, JanetByteView *in) {
+    if (n > INT32_MAX) {
+        janet_panic("Output too large");
+    }
+
+    ptrdiff_t offset = -1;
+    if (in && buf->data && in->bytes >= buf->data &&
+        in->bytes < buf->data + buf->capacity) {
+        offset = in->bytes - buf->data;
+    }
+
+    janet_buffer_extra(buf, (int32_t)n);
+    if (offset >= 0) {
+        in->bytes = buf->data + offset;
+    }
+
+    return buf->data + buf->count;
+}
+
+#define CODEC_HEX       0
+#define CODEC_BASE64    1
+#define CODEC_BASE64URL 2
+
+typedef struct botan_codec_obj {
+    int kind;
+    bool is_encode;
+    uint8_t carry[4];
+    size_t carry_len;
+} botan_codec_obj_t;
+
+/* Abstract Object functions */
+static int codec_get_fn(void *data, Janet key, Janet *out);
+static void codec_tostring_fn(void *p, JanetBuffer *buffer);
+
+/* Janet functions */
+static Janet codec_new(int32_t argc, Janet *argv);
+static Janet codec_update(int32_t argc, Janet *argv);
+static Janet codec_finish(int32_t argc, Janet *argv);
+
+static JanetAbstractType codec_obj_type = {
+    "botan/codec",
+    NULL,
+    NULL,
+    codec_get_fn,
+    NULL,   // put
+    NULL,   // marshal
+    NULL,   // unmarshal
+    codec_tostring_fn,
+    JANET_ATEND_TOSTRING
+};
+
+static JanetMethod codec_methods[] = {
+    {"update", codec_update},
+    {"finish", codec_finish},
+    {NULL, NULL},
+};
+
+static JanetAbstractType *get_codec_obj_type() {
+    return &codec_obj_type;
+}
+
+/* Abstract Object functions */
+static int codec_get_fn(void *data, Janet key, Janet *out) {
+    (void)data;
+    if (!janet_checktype(key, JANET_KEYWORD)) {
+        return 0;
+    }
+
+    return janet_getmethod(janet_unwrap_keyword(key), codec_methods, out);
+}
+
+static void codec_tostring_fn(void *p, JanetBuffer *buffer) {
+    botan_codec_obj_t *obj = (botan_codec_obj_t *)p;
+
+    const char *kinds[] = {"hex", "base64", "base64url"};
+
+    janet_formatb(buffer, "[%s, %s]", kinds[obj->kind],
+                  obj->is_encode ? "Encode" : "Decode");
+}
+
+/* Codec helpers */
+
+static void hex_encode_append(JanetBuffer *buf, JanetByteView in) {
+    uint8_t *out = buffer_reserve_out(buf, (size_t)in.len * 2, &in);
+
+    codec_hex_encode(in.bytes, in.len, out);
+    buf->count += in.len * 2;
+}
+
+static void hex_decode_append(JanetBuffer *buf, JanetByteView in) {
+    size_t out_len = 0;
+    uint8_t *out = buffer_reserve_out(buf, in.len / 2, &in);
+
+    int ret = codec_hex_decode(in.bytes, in.len, out, &out_len);
+    JANET_BOTAN_ASSERT(ret);
+
+    buf->count += (int32_t)out_len;
+}
+
+static void base64_encode_append(JanetBuffer *buf, JanetByteView in, int url, bool padding) {
+    size_t out_len = codec_base64_encoded_len(in.len, padding);
+    uint8_t *out = buffer_reserve_out(buf, out_len, &in);
+
+    buf->count += (int32_t)codec_base64_encode(in.bytes, in.len, out, url, padding);
+}
+
+static void base64_decode_append(JanetBuffer *buf, JanetByteView in, int url) {
+    size_t out_len = (((size_t)in.len + 3) / 4) * 3;
+    uint8_t *out = buffer_reserve_out(buf, out_len, &in);
+
+    int ret = codec_base64_decode(in.bytes, in.len, out, &out_len, url);
+    JANET_BOTAN_ASSERT(ret);
+
+    buf->count += (int32_t)out_len;
+}
+
+/* Constant time comparison helpers */
+
+#if defined(JBOTAN_CODEC_X86)
+__attribute__((target("avx2")))
+static uint64_t ct_diff_avx2(const uint8_t *x, const uint8_t *y, size_t len, size_t *done) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(x + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(y + i));
+        acc = _mm256_or_si256(acc, _mm256_xor_si256(a, b));
+    }
+
+    *done = i;
+    return (uint64_t)!_mm256_testz_si256(acc, acc);
+}
+#endif
+
+/* OR of the XOR of `x` and `y` over `len` bytes. Every byte is always read;
+ * the running time depends on `len` only. */
+static uint64_t ct_diff(const uint8_t *x, const uint8_t *y, size_t len) {
+    uint64_t acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    size_t i = 0;
+
+#if defined(JBOTAN_CODEC_X86)
+    if (len >= 256 && codec_simd_level() == CODEC_SIMD_AVX2) {
+        acc0 = ct_diff_avx2(x, y, len, &i);
+    }
+#endif
+
+    for (; i + 32 <= len; i += 32) {
+        uint64_t a[4], b[4];
+        memcpy(a, x + i, 32);
+        memcpy(b, y + i, 32);
+        acc0 |= a[0] ^ b[0];
+        acc1 |= a[1] ^ b[1];
+        acc2 |= a[2] ^ b[2];
+        acc3 |= a[3] ^ b[3];
+    }
+
+    for (; i < len; i++) {
+        acc0 |= (uint64_t)(x[i] ^ y[i]);
+    }
+
+    return acc0 | acc1 | acc2 | acc3;
+}
+
+/* Returns 1 if `x` equals `y`, otherwise 0, without branching on the
+ * content of either. A length mismatch still compares `x.len` bytes. */
+static int ct_equal(JanetByteView x, JanetByteView y) {
+    uint64_t diff = (uint64_t)(x.len ^ y.len);
+    int32_t common = x.len < y.len ? x.len : y.len;
+
+    diff |= ct_diff(x.bytes, y.bytes, common);
+    if (common < x.len) {
+        diff |= ct_diff(x.bytes + common, x.bytes, x.len - common);
+    }
+
+    return (int)(((diff | (0 - diff)) >> 63) ^ 1);
+}
+
+/* Janet functions */
 static Janet cfun_constant_time_compare(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 2);
     JanetByteView x = janet_getbytes(argv, 0);
     JanetByteView y = janet_getbytes(argv, 1);
-    if (x.len != y.len)
-        return janet_wrap_false();
 
-    int ret = botan_constant_time_compare(x.bytes, y.bytes, x.len);
-    return janet_wrap_boolean(ret == 0);
+    return janet_wrap_boolean(ct_equal(x, y));
+}
+
+static Janet cfun_constant_time_compare_many(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+    JanetByteView expected = janet_getbytes(argv, 0);
+    JanetView candidates = janet_getindexed(argv, 1);
+    int32_t found = -1;
+
+    for (int32_t i = 0; i < candidates.len; i++) {
+        JanetByteView candidate;
+        if (!janet_bytes_view(candidates.items[i], &candidate.bytes, &candidate.len)) {
+            janet_panicf("expected bytes at index %d", i);
+        }
+
+        /* Select the first match with a mask instead of a branch. */
+        int32_t match = -(int32_t)ct_equal(expected, candidate);
+        int32_t unset = found >> 31;
+        found = (found & ~(match & unset)) | (i & match & unset);
+    }
+
+    return found < 0 ? janet_wrap_nil() : janet_wrap_number((double)found);
 }
 
 static Janet cfun_hex_encode(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 1);
     JanetByteView bin = janet_getbytes(argv, 0);
-    JanetBuffer *encoded = janet_buffer(bin.len * 2);
+    uint8_t *encoded = janet_string_begin(bin.len * 2);
 
-    int ret = botan_hex_encode(bin.bytes, bin.len, (char*)encoded->data, 0);
-    JANET_BOTAN_ASSERT(ret);
+    codec_hex_encode(bin.bytes, bin.len, encoded);
 
-    encoded->count = bin.len * 2;
-    return janet_wrap_string(janet_string(encoded->data, encoded->count));
+    return janet_wrap_string(janet_string_end(encoded));
 }
 
 static Janet cfun_hex_decode(int32_t argc, Janet *argv) {
     janet_fixarity(argc, 1);
     JanetByteView str = janet_getbytes(argv, 0);
-    JanetBuffer *decoded = janet_buffer(str.len);
-    size_t out_len = str.len;
+    JanetBuffer *decoded = janet_buffer(str.len / 2);
 
-    int ret = botan_hex_decode((const char *)str.bytes, str.len, (uint8_t *)decoded->data, &out_len);
-    JANET_BOTAN_ASSERT(ret);
+    hex_decode_append(decoded, str);
 
-    decoded->count = out_len;
     return janet_wrap_string(janet_string(decoded->data, decoded->count));
 }
 
-static Janet cfun_base64_encode(int32_t argc, Janet *argv) {
-    janet_fixarity(argc, 1);
+static Janet base64_encode_string(int32_t argc, Janet *argv, int url) {
+    janet_arity(argc, 1, 2);
     JanetByteView bin = janet_getbytes(argv, 0);
-    size_t out_len = ((bin.len + 2) / 3) * 4 + 1;
-    JanetBuffer *encoded = janet_buffer(out_len);
-
-    int ret = botan_base64_encode(bin.bytes, bin.len, (char *)encoded->data, &out_len);
-    JANET_BOTAN_ASSERT(ret);
+    bool padding = janet_optboolean(argv, argc, 1, !url);
+    uint8_t *encoded = janet_string_begin(codec_base64_encoded_len(bin.len, padding));
 
-    /* Remove null terminator */
-    if (out_len > 0 && encoded->data[out_len - 1] == 0) {
-        out_len -= 1;
-    }
+    codec_base64_encode(bin.bytes, bin.len, encoded, url, padding);
 
-    return janet_wrap_string(janet_string(encoded->data, out_len));
+    return janet_wrap_string(janet_string_end(encoded));
 }
 
-static Janet cfun_base64_decode(int32_t argc, Janet *argv) {
+static Janet base64_decode_string(int32_t argc, Janet *argv, int url) {
     janet_fixarity(argc, 1);
     JanetByteView str = janet_getbytes(argv, 0);
-    size_t out_len = ((str.len + 3) / 4) * 3;
-    JanetBuffer *decoded = janet_buffer(out_len);
+    JanetBuffer *decoded = janet_buffer(((str.len + 3) / 4) * 3);
 
-    int ret = botan_base64_decode((const char *)str.bytes, str.len, decoded->data, &out_len);
-    JANET_BOTAN_ASSERT(ret);
+    base64_decode_append(decoded, str, url);
+
+    return janet_wrap_string(janet_string(decoded->data, decoded->count));
+}
+
+static Janet cfun_base64_encode(int32_t argc, Janet *argv) {
+    return base64_encode_string(argc, argv, 0);
+}
+
+static Janet cfun_base64_decode(int32_t argc, Janet *argv) {
+    return base64_decode_string(argc, argv, 0);
+}
+
+static Janet cfun_base64url_encode(int32_t argc, Janet *argv) {
+    return base64_encode_string(argc, argv, 1);
+}
+
+static Janet cfun_base64url_decode(int32_t argc, Janet *argv) {
+    return base64_decode_string(argc, argv, 1);
+}
+
+static Janet cfun_hex_encode_into(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+    JanetBuffer *buf = janet_getbuffer(argv, 0);
+    JanetByteView bin = janet_getbytes(argv, 1);
+
+    hex_encode_append(buf, bin);
+    return janet_wrap_buffer(buf);
+}
+
+static Janet cfun_hex_decode_into(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+    JanetBuffer *buf = janet_getbuffer(argv, 0);
+    JanetByteView str = janet_getbytes(argv, 1);
+
+    hex_decode_append(buf, str);
+    return janet_wrap_buffer(buf);
+}
+
+static Janet base64_encode_buffer(int32_t argc, Janet *argv, int url) {
+    janet_arity(argc, 2, 3);
+    JanetBuffer *buf = janet_getbuffer(argv, 0);
+    JanetByteView bin = janet_getbytes(argv, 1);
+    bool padding = janet_optboolean(argv, argc, 2, !url);
 
-    return janet_wrap_string(janet_string(decoded->data, out_len));
+    base64_encode_append(buf, bin, url, padding);
+    return janet_wrap_buffer(buf);
+}
+
+static Janet base64_decode_buffer(int32_t argc, Janet *argv, int url) {
+    janet_fixarity(argc, 2);
+    JanetBuffer *buf = janet_getbuffer(argv, 0);
+    JanetByteView str = janet_getbytes(argv, 1);
+
+    base64_decode_append(buf, str, url);
+    return janet_wrap_buffer(buf);
+}
+
+static Janet cfun_base64_encode_into(int32_t argc, Janet *argv) {
+    return base64_encode_buffer(argc, argv, 0);
+}
+
+static Janet cfun_base64_decode_into(int32_t argc, Janet *argv) {
+    return base64_decode_buffer(argc, argv, 0);
+}
+
+static Janet cfun_base64url_encode_into(int32_t argc, Janet *argv) {
+    return base64_encode_buffer(argc, argv, 1);
+}
+
+static Janet cfun_base64url_decode_into(int32_t argc, Janet *argv) {
+    return base64_decode_buffer(argc, argv, 1);
+}
+
+static Janet codec_new(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 2);
+    JanetKeyword kind = janet_getkeyword(argv, 0);
+    JanetKeyword direction = janet_getkeyword(argv, 1);
+
+    botan_codec_obj_t *obj = janet_abstract(&codec_obj_type, sizeof(botan_codec_obj_t));
+    memset(obj, 0, sizeof(botan_codec_obj_t));
+
+    if (janet_cstrcmp(kind, "hex") == 0) {
+        obj->kind = CODEC_HEX;
+    } else if (janet_cstrcmp(kind, "base64") == 0) {
+        obj->kind = CODEC_BASE64;
+    } else if (janet_cstrcmp(kind, "base64url") == 0) {
+        obj->kind = CODEC_BASE64URL;
+    } else {
+        janet_panic("Unexpected argument");
+    }
+
+    if (janet_cstrcmp(direction, "encode") == 0) {
+        obj->is_encode = true;
+    } else if (janet_cstrcmp(direction, "decode") == 0) {
+        obj->is_encode = false;
+    } else {
+        janet_panic("Unexpected argument");
+    }
+
+    return janet_wrap_abstract(obj);
+}
+
+/* Base64 encoding consumes whole 3-byte groups; the remainder is carried
+ * over to the next update. */
+static void codec_base64_encode_update(botan_codec_obj_t *obj, JanetBuffer *buf,
+                                       JanetByteView in) {
+    int url = obj->kind == CODEC_BASE64URL;
+
+    if (obj->carry_len > 0) {
+        while (obj->carry_len < 3 && in.len > 0) {
+            obj->carry[obj->carry_len++] = in.bytes[0];
+            in.bytes++;
+            in.len--;
+        }
+        if (obj->carry_len < 3) {
+            return;
+        }
+
+        JanetByteView group = {obj->carry, 3};
+        base64_encode_append(buf, group, url, !url);
+        obj->carry_len = 0;
+    }
+
+    int32_t whole = in.len - (in.len % 3);
+    memcpy(obj->carry, in.bytes + whole, in.len - whole);
+    obj->carry_len = in.len - whole;
+
+    JanetByteView body = {in.bytes, whole};
+    if (whole > 0) {
+        base64_encode_append(buf, body, url, !url);
+    }
+}
+
+/* Decoders skip whitespace and consume whole quads (base64) or pairs (hex);
+ * a trailing partial group is carried over to the next update. */
+static void codec_decode_update(botan_codec_obj_t *obj, JanetBuffer *buf,
+                                JanetByteView in) {
+    size_t group = obj->kind == CODEC_HEX ? 2 : 4;
+    uint8_t *chars = janet_smalloc(obj->carry_len + in.len);
+    size_t n = obj->carry_len;
+
+    memcpy(chars, obj->carry, obj->carry_len);
+    for (int32_t i = 0; i < in.len; i++) {
+        if (!codec_is_space(in.bytes[i])) {
+            chars[n++] = in.bytes[i];
+        }
+    }
+
+    size_t whole = n - (n % group);
+    JanetByteView body = {chars, (int32_t)whole};
+    if (whole > 0) {
+        if (obj->kind == CODEC_HEX) {
+            hex_decode_append(buf, body);
+        } else {
+            base64_decode_append(buf, body, obj->kind == CODEC_BASE64URL);
+        }
+    }
+
+    memcpy(obj->carry, chars + whole, n - whole);
+    obj->carry_len = n - whole;
+    janet_sfree(chars);
+}
+
+static Janet codec_update(int32_t argc, Janet *argv) {
+    janet_arity(argc, 2, 3);
+    botan_codec_obj_t *obj = janet_getabstract(argv, 0, get_codec_obj_type());
+    JanetByteView in = janet_getbytes(argv, 1);
+    JanetBuffer *buf = janet_optbuffer(argv, argc, 2, in.len);
+
+    if (!obj->is_encode) {
+        codec_decode_update(obj, buf, in);
+    } else if (obj->kind == CODEC_HEX) {
+        hex_encode_append(buf, in);
+    } else {
+        codec_base64_encode_update(obj, buf, in);
+    }
+
+    return janet_wrap_buffer(buf);
+}
+
+static Janet codec_finish(int32_t argc, Janet *argv) {
+    janet_arity(argc, 1, 2);
+    botan_codec_obj_t *obj = janet_getabstract(argv, 0, get_codec_obj_type());
+    JanetBuffer *buf = janet_optbuffer(argv, argc, 1, 4);
+    size_t carry_len = obj->carry_len;
+
+    obj->carry_len = 0;
+    if (carry_len == 0) {
+        return janet_wrap_buffer(buf);
+    }
+
+    /* Unpadded base64 is accepted, a lone character or hex nibble is not. */
+    int url = obj->kind == CODEC_BASE64URL;
+    JanetByteView rest = {obj->carry, (int32_t)carry_len};
+    if (obj->is_encode) {
+        base64_encode_append(buf, rest, url, !url);
+    } else if (obj->kind != CODEC_HEX && carry_len > 1) {
+        base64_decode_append(buf, rest, url);
+    } else {
+        janet_panic("Incomplete input");
+    }
+
+    return janet_wrap_buffer(buf);
 }
 
 static JanetReg utility_cfuns[] = {
     {"constant-time-compare", cfun_constant_time_compare,
      "(constant-time-compare x y)\n\n"
-     "Check if buffer `x` equals buffer `y`. Returns a boolean."
+     "Check if buffer `x` equals buffer `y`. Returns a boolean. The running "
+     "time depends only on the lengths of `x` and `y`."
+    },
+    {"constant-time-compare-many", cfun_constant_time_compare_many,
+     "(constant-time-compare-many expected candidates)\n\n"
+     "Compare `expected` against every buffer in the indexed collection "
+     "`candidates`. All candidates are always compared in full, so the "
+     "running time does not reveal which one matched. Returns the index of "
+     "the first matching candidate, or nil if none matches."
     },
     {"hex-encode", cfun_hex_encode, "(hex-encode bin)\n\n"
      "Performs hex encoding of binary data in `bin`. Returns the string."
@@ -83,17 +482,78 @@ static JanetReg utility_cfuns[] = {
     {"hex-decode", cfun_hex_decode, "(hex-decode str)\n\n"
      "Performs hex decoding of string data in `str`. Returns the string."
     },
-    {"base64-encode", cfun_base64_encode, "(base64-encode bin)\n\n"
-     "Performs base64 encoding of binary data in `bin`. Returns the string."
+    {"base64-encode", cfun_base64_encode, "(base64-encode bin &opt padding)\n\n"
+     "Performs base64 encoding of binary data in `bin`. Trailing `=` "
+     "padding is added unless `padding` is false. Returns the string."
     },
     {"base64-decode", cfun_base64_decode, "(base64-decode str)\n\n"
-     "Performs base64 decoding of string data in `str`. Returns the string."
+     "Performs base64 decoding of string data in `str`. Padding is "
+     "optional. Returns the string."
+    },
+    {"base64url-encode", cfun_base64url_encode,
+     "(base64url-encode bin &opt padding)\n\n"
+     "Performs base64 encoding of binary data in `bin` with the URL and "
+     "filename safe alphabet of RFC 4648. Padding is omitted unless "
+     "`padding` is true. Returns the string."
+    },
+    {"base64url-decode", cfun_base64url_decode, "(base64url-decode str)\n\n"
+     "Performs base64url decoding of string data in `str`. Padding is "
+     "optional. Returns the string."
+    },
+    {"hex-encode-into", cfun_hex_encode_into, "(hex-encode-into buf bin)\n\n"
+     "Performs hex encoding of binary data in `bin` and appends the result "
+     "to `buf`. Returns `buf`."
+    },
+    {"hex-decode-into", cfun_hex_decode_into, "(hex-decode-into buf str)\n\n"
+     "Performs hex decoding of string data in `str` and appends the result "
+     "to `buf`. Returns `buf`."
+    },
+    {"base64-encode-into", cfun_base64_encode_into,
+     "(base64-encode-into buf bin &opt padding)\n\n"
+     "Performs base64 encoding of binary data in `bin` and appends the "
+     "result to `buf`. Trailing `=` padding is added unless `padding` is "
+     "false. Returns `buf`."
+    },
+    {"base64-decode-into", cfun_base64_decode_into,
+     "(base64-decode-into buf str)\n\n"
+     "Performs base64 decoding of string data in `str` and appends the "
+     "result to `buf`. Returns `buf`."
+    },
+    {"base64url-encode-into", cfun_base64url_encode_into,
+     "(base64url-encode-into buf bin &opt padding)\n\n"
+     "Performs base64url encoding of binary data in `bin` and appends the "
+     "result to `buf`. Padding is omitted unless `padding` is true. "
+     "Returns `buf`."
+    },
+    {"base64url-decode-into", cfun_base64url_decode_into,
+     "(base64url-decode-into buf str)\n\n"
+     "Performs base64url decoding of string data in `str` and appends the "
+     "result to `buf`. Returns `buf`."
+    },
+    {"codec/new", codec_new, "(codec/new kind direction)\n\n"
+     "Create an incremental encoder or decoder. `kind` should be one of "
+     ":hex, :base64 or :base64url (unpadded), and `direction` one of :encode or :decode. Partial "
+     "groups of input are carried between updates, so data may be fed in "
+     "chunks of any size. Returns `codec-obj`."
+    },
+    {"codec/update", codec_update, "(codec/update codec-obj input &opt buf)\n\n"
+     "Feed `input` to the codec and append all output that can be produced "
+     "so far to `buf`. Whitespace in decoder input is skipped. A new buffer "
+     "is used if `buf` is not provided. Returns the buffer."
+    },
+    {"codec/finish", codec_finish, "(codec/finish codec-obj &opt buf)\n\n"
+     "Flush the remaining input of the codec into `buf`, adding base64 "
+     "padding if needed. A base64 decoder accepts input without padding, "
+     "otherwise an error is raised if a decoder holds an incomplete "
+     "group. Afterwards, the `codec-obj` is reset and may be used again. "
+     "Returns the buffer."
     },
     {NULL, NULL, NULL}
 };
 
 static void submod_utility(JanetTable *env) {
     janet_cfuns(env, "botan", utility_cfuns);
+    janet_register_abstract_type(get_codec_obj_type());
 }
 
 #endif /* BOTAN_UTILITY_H */
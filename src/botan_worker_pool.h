@@ -0,0 +1,451 @@
+/*
+ * Copyright (c) 2024, Janet-botan Seungki Kim
+ *
+ * Janet-botan is released under the MIT License, see the LICENSE file.
+ */
+
+#ifndef BOTAN_WORKER_POOL_H
+#define BOTAN_WORKER_POOL_H
+
+/*
+ * Native worker pool
+ *
+ * Slow operations (password hashing and the like) can be handed to a fixed
+ * set of native threads so that the calling fiber yields to the event loop
+ * instead of blocking every fiber on the thread. The pool is shared by all
+ * Janet threads of the process. Jobs wait in a FIFO queue whose depth is
+ * bounded; submitting to a full queue raises an error right away so that
+ * callers see backpressure instead of unbounded latency.
+ *
+ * A job runs in three steps:
+ *   run      on a worker thread; must not touch the Janet VM. Returns a
+ *            Botan FFI status code.
+ *   finish   on the submitting VM thread when run returned a non-negative
+ *            status; builds the value the fiber is resumed with. A panic
+ *            here is raised in the fiber.
+ *   release  on the submitting VM thread, always; frees the job.
+ * A negative status resumes the fiber with the matching Botan error.
+ *
+ * worker_pool_parallel_for is a blocking fork-join on the same threads:
+ * the caller works through the tasks itself and idle workers help out.
+ * Helper jobs have no VM and post no completion event.
+ */
+
+typedef struct jbotan_job jbotan_job_t;
+
+struct jbotan_job {
+    jbotan_job_t *next;
+    int (*run)(jbotan_job_t *job);
+    Janet (*finish)(jbotan_job_t *job);
+    void (*release)(jbotan_job_t *job);
+    JanetVM *vm;
+    JanetFiber *fiber;
+    int status;
+};
+
+typedef struct worker_pool {
+    jbotan_job_t *head;
+    jbotan_job_t *tail;
+    size_t threads;
+    size_t max_pending;
+    size_t pending;
+    size_t running;
+    size_t completed;
+    size_t rejected;
+    bool started;
+} worker_pool_t;
+
+static worker_pool_t worker_pool;
+
+#ifdef JANET_WINDOWS
+static SRWLOCK worker_pool_lock = SRWLOCK_INIT;
+static CONDITION_VARIABLE worker_pool_cond = CONDITION_VARIABLE_INIT;
+static CONDITION_VARIABLE worker_pool_done_cond = CONDITION_VARIABLE_INIT;
+#define WORKER_POOL_LOCK()   AcquireSRWLockExclusive(&worker_pool_lock)
+#define WORKER_POOL_UNLOCK() ReleaseSRWLockExclusive(&worker_pool_lock)
+#define WORKER_POOL_WAIT()   SleepConditionVariableSRW(&worker_pool_cond, &worker_pool_lock, INFINITE, 0)
+#define WORKER_POOL_SIGNAL() WakeConditionVariable(&worker_pool_cond)
+#define WORKER_POOL_WAIT_DONE()      SleepConditionVariableSRW(&worker_pool_done_cond, &worker_pool_lock, INFINITE, 0)
+#define WORKER_POOL_BROADCAST_DONE() WakeAllConditionVariable(&worker_pool_done_cond)
+#else
+static pthread_mutex_t worker_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_pool_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t worker_pool_done_cond = PTHREAD_COND_INITIALIZER;
+#define WORKER_POOL_LOCK()   pthread_mutex_lock(&worker_pool_lock)
+#define WORKER_POOL_UNLOCK() pthread_mutex_unlock(&worker_pool_lock)
+#define WORKER_POOL_WAIT()   pthread_cond_wait(&worker_pool_cond, &worker_pool_lock)
+#define WORKER_POOL_SIGNAL() pthread_cond_signal(&worker_pool_cond)
+#define WORKER_POOL_WAIT_DONE()      pthread_cond_wait(&worker_pool_done_cond, &worker_pool_lock)
+#define WORKER_POOL_BROADCAST_DONE() pthread_cond_broadcast(&worker_pool_done_cond)
+#endif
+
+static size_t worker_pool_cpu_count(void) {
+#ifdef JANET_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (size_t)info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t)n : 1;
+#endif
+}
+
+/* Called with the lock held. */
+static void worker_pool_defaults(void) {
+    if (worker_pool.threads == 0) {
+        worker_pool.threads = worker_pool_cpu_count();
+    }
+    if (worker_pool.max_pending == 0) {
+        worker_pool.max_pending = worker_pool.threads * 8;
+    }
+}
+
+/* Runs outside of any fiber, so a panic in finish is caught here and
+ * raised in the waiting fiber instead; the job is released either way. */
+static void worker_pool_complete(JanetEVGenericMessage msg) {
+    jbotan_job_t *job = (jbotan_job_t *)msg.argp;
+    JanetFiber *fiber = job->fiber;
+
+    if (janet_fiber_can_resume(fiber)) {
+        if (job->status < 0) {
+            janet_cancel(fiber, janet_cstringv(getBotanError(job->status)));
+        } else {
+            JanetTryState state;
+            if (janet_try(&state) == JANET_SIGNAL_OK) {
+                Janet value = job->finish(job);
+                janet_restore(&state);
+                janet_schedule(fiber, value);
+            } else {
+                janet_restore(&state);
+                janet_cancel(fiber, state.payload);
+            }
+        }
+    }
+    janet_gcunroot(janet_wrap_fiber(fiber));
+    job->release(job);
+}
+
+static void worker_pool_loop(void) {
+    for (;;) {
+        WORKER_POOL_LOCK();
+        while (worker_pool.head == NULL) {
+            WORKER_POOL_WAIT();
+        }
+        jbotan_job_t *job = worker_pool.head;
+        worker_pool.head = job->next;
+        if (worker_pool.head == NULL) {
+            worker_pool.tail = NULL;
+        }
+        worker_pool.pending--;
+        worker_pool.running++;
+        WORKER_POOL_UNLOCK();
+
+        JanetVM *vm = job->vm;
+        int status = job->run(job);
+
+        WORKER_POOL_LOCK();
+        worker_pool.running--;
+        if (vm != NULL) {
+            worker_pool.completed++;
+        }
+        WORKER_POOL_UNLOCK();
+        if (vm == NULL) {
+            /* A helper job may be gone as soon as its run returned. */
+            continue;
+        }
+
+        job->status = status;
+
+        JanetEVGenericMessage msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.argp = job;
+        janet_ev_post_event(job->vm, worker_pool_complete, msg);
+    }
+}
+
+#ifdef JANET_WINDOWS
+static DWORD WINAPI worker_pool_thread(LPVOID arg) {
+    (void)arg;
+    worker_pool_loop();
+    return 0;
+}
+#else
+static void *worker_pool_thread(void *arg) {
+    (void)arg;
+    worker_pool_loop();
+    return NULL;
+}
+#endif
+
+/* Called with the lock held. Returns the number of threads started. */
+static size_t worker_pool_start(void) {
+    size_t started = 0;
+
+    for (size_t i = 0; i < worker_pool.threads; i++) {
+#ifdef JANET_WINDOWS
+        HANDLE thread = CreateThread(NULL, 0, worker_pool_thread, NULL, 0, NULL);
+        if (thread == NULL) {
+            break;
+        }
+        CloseHandle(thread);
+#else
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, worker_pool_thread, NULL) != 0) {
+            break;
+        }
+        pthread_detach(thread);
+#endif
+        started++;
+    }
+
+    if (started > 0) {
+        worker_pool.threads = started;
+        worker_pool.started = true;
+    }
+    return started;
+}
+
+/* Queue `job` and suspend the current fiber until it completes. On a full
+ * queue the job is released and an error is raised in the caller. */
+static JANET_NO_RETURN void worker_pool_await(jbotan_job_t *job) {
+    WORKER_POOL_LOCK();
+    worker_pool_defaults();
+    if (!worker_pool.started && worker_pool_start() == 0) {
+        WORKER_POOL_UNLOCK();
+        job->release(job);
+        janet_panic("Failed to start worker pool threads");
+    }
+    if (worker_pool.pending >= worker_pool.max_pending) {
+        size_t pending = worker_pool.pending;
+        worker_pool.rejected++;
+        WORKER_POOL_UNLOCK();
+        job->release(job);
+        janet_panicf("Worker pool queue is full (%d jobs pending)", (int32_t)pending);
+    }
+
+    job->next = NULL;
+    job->vm = janet_local_vm();
+    job->fiber = janet_root_fiber();
+    job->status = 0;
+    janet_gcroot(janet_wrap_fiber(job->fiber));
+    janet_ev_inc_refcount();
+
+    if (worker_pool.tail) {
+        worker_pool.tail->next = job;
+    } else {
+        worker_pool.head = job;
+    }
+    worker_pool.tail = job;
+    worker_pool.pending++;
+    WORKER_POOL_SIGNAL();
+    WORKER_POOL_UNLOCK();
+
+    janet_await();
+}
+
+typedef int (*worker_pool_task_fn)(void *ctx, size_t index);
+
+#define WORKER_POOL_MAX_HELPERS 64
+
+typedef struct worker_pool_batch {
+    worker_pool_task_fn fn;
+    void *ctx;
+    size_t count;
+    size_t next;
+    size_t helpers;
+    int status;
+} worker_pool_batch_t;
+
+typedef struct worker_pool_helper {
+    jbotan_job_t job;
+    worker_pool_batch_t *batch;
+} worker_pool_helper_t;
+
+/* Claim and run tasks of `batch` until none are left or one failed. */
+static void worker_pool_batch_work(worker_pool_batch_t *batch) {
+    for (;;) {
+        WORKER_POOL_LOCK();
+        if (batch->next >= batch->count || batch->status < 0) {
+            WORKER_POOL_UNLOCK();
+            return;
+        }
+        size_t index = batch->next++;
+        WORKER_POOL_UNLOCK();
+
+        int ret = batch->fn(batch->ctx, index);
+        if (ret < 0) {
+            WORKER_POOL_LOCK();
+            if (batch->status == 0) {
+                batch->status = ret;
+            }
+            WORKER_POOL_UNLOCK();
+        }
+    }
+}
+
+static int worker_pool_helper_run(jbotan_job_t *job) {
+    worker_pool_batch_t *batch = ((worker_pool_helper_t *)job)->batch;
+
+    worker_pool_batch_work(batch);
+
+    WORKER_POOL_LOCK();
+    batch->helpers--;
+    WORKER_POOL_BROADCAST_DONE();
+    WORKER_POOL_UNLOCK();
+    return 0;
+}
+
+/* Run `fn(ctx, i)` for every i below `count` on the calling thread and up
+ * to `threads - 1` workers, and return once all of them have finished.
+ * Helpers only take free queue slots, so this never fails for lack of
+ * workers; it just runs with less parallelism. Returns the first negative
+ * status of a task, or 0. Safe to call from a worker thread. */
+static int worker_pool_parallel_for(worker_pool_task_fn fn, void *ctx,
+                                    size_t count, size_t threads) {
+    worker_pool_batch_t batch = {fn, ctx, count, 0, 0, 0};
+    worker_pool_helper_t helpers[WORKER_POOL_MAX_HELPERS];
+    size_t n = 0;
+
+    if (threads > count) {
+        threads = count;
+    }
+    if (threads > 1) {
+        WORKER_POOL_LOCK();
+        worker_pool_defaults();
+        if (worker_pool.started || worker_pool_start() > 0) {
+            n = threads - 1;
+            if (n > worker_pool.threads) {
+                n = worker_pool.threads;
+            }
+            if (n > WORKER_POOL_MAX_HELPERS) {
+                n = WORKER_POOL_MAX_HELPERS;
+            }
+            if (worker_pool.pending + n > worker_pool.max_pending) {
+                n = worker_pool.max_pending > worker_pool.pending ?
+                    worker_pool.max_pending - worker_pool.pending : 0;
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            jbotan_job_t *job = &helpers[i].job;
+            memset(job, 0, sizeof(jbotan_job_t));
+            job->run = worker_pool_helper_run;
+            helpers[i].batch = &batch;
+
+            if (worker_pool.tail) {
+                worker_pool.tail->next = job;
+            } else {
+                worker_pool.head = job;
+            }
+            worker_pool.tail = job;
+            worker_pool.pending++;
+            WORKER_POOL_SIGNAL();
+        }
+        batch.helpers = n;
+        WORKER_POOL_UNLOCK();
+    }
+
+    worker_pool_batch_work(&batch);
+
+    if (n > 0) {
+        WORKER_POOL_LOCK();
+        /* Helpers no worker has picked up yet are dropped from the queue. */
+        jbotan_job_t *prev = NULL;
+        jbotan_job_t *job = worker_pool.head;
+        while (job) {
+            jbotan_job_t *next = job->next;
+            if (job->run == worker_pool_helper_run &&
+                ((worker_pool_helper_t *)job)->batch == &batch) {
+                if (prev) {
+                    prev->next = next;
+                } else {
+                    worker_pool.head = next;
+                }
+                if (worker_pool.tail == job) {
+                    worker_pool.tail = prev;
+                }
+                worker_pool.pending--;
+                batch.helpers--;
+            } else {
+                prev = job;
+            }
+            job = next;
+        }
+        while (batch.helpers > 0) {
+            WORKER_POOL_WAIT_DONE();
+        }
+        WORKER_POOL_UNLOCK();
+    }
+
+    return batch.status;
+}
+
+static Janet worker_pool_stats_struct(void) {
+    WORKER_POOL_LOCK();
+    worker_pool_defaults();
+    worker_pool_t pool = worker_pool;
+    WORKER_POOL_UNLOCK();
+
+    JanetKV *st = janet_struct_begin(7);
+    janet_struct_put(st, janet_ckeywordv("threads"), janet_wrap_number((double)pool.threads));
+    janet_struct_put(st, janet_ckeywordv("queue-depth"), janet_wrap_number((double)pool.max_pending));
+    janet_struct_put(st, janet_ckeywordv("started"), janet_wrap_boolean(pool.started));
+    janet_struct_put(st, janet_ckeywordv("pending"), janet_wrap_number((double)pool.pending));
+    janet_struct_put(st, janet_ckeywordv("running"), janet_wrap_number((double)pool.running));
+    janet_struct_put(st, janet_ckeywordv("completed"), janet_wrap_number((double)pool.completed));
+    janet_struct_put(st, janet_ckeywordv("rejected"), janet_wrap_number((double)pool.rejected));
+    return janet_wrap_struct(janet_struct_end(st));
+}
+
+/* Janet functions */
+static Janet worker_pool_configure(int32_t argc, Janet *argv) {
+    janet_arity(argc, 0, 2);
+    size_t threads = janet_optsize(argv, argc, 0, 0);
+    size_t queue_depth = janet_optsize(argv, argc, 1, 0);
+
+    WORKER_POOL_LOCK();
+    if (threads > 0 && threads != worker_pool.threads) {
+        if (worker_pool.started) {
+            WORKER_POOL_UNLOCK();
+            janet_panic("Worker pool threads are already running");
+        }
+        worker_pool.threads = threads;
+    }
+    if (queue_depth > 0) {
+        worker_pool.max_pending = queue_depth;
+    }
+    WORKER_POOL_UNLOCK();
+
+    return worker_pool_stats_struct();
+}
+
+static Janet worker_pool_stats(int32_t argc, Janet *argv) {
+    janet_fixarity(argc, 0);
+    return worker_pool_stats_struct();
+}
+
+static JanetReg worker_pool_cfuns[] = {
+    {"worker-pool/configure", worker_pool_configure,
+     "(worker-pool/configure &opt threads queue-depth)\n\n"
+     "Set the number of native worker `threads` used by the `-async` "
+     "functions and the maximum number of jobs allowed to wait in the "
+     "queue. The thread count can only be changed before the first job is "
+     "submitted; it defaults to the number of CPU cores. The queue depth "
+     "defaults to 8 jobs per thread and can be changed at any time. "
+     "Omitted or nil arguments keep the current value. Returns the same "
+     "struct as `worker-pool/stats`."
+    },
+    {"worker-pool/stats", worker_pool_stats,
+     "(worker-pool/stats)\n\n"
+     "Returns a struct with the pool configuration (`:threads`, "
+     "`:queue-depth`, `:started`) and its counters: jobs `:pending` in the "
+     "queue, `:running` on a worker, `:completed`, and `:rejected` because "
+     "the queue was full."
+    },
+    {NULL, NULL, NULL}
+};
+
+static void submod_worker_pool(JanetTable *env) {
+    janet_cfuns(env, "botan", worker_pool_cfuns);
+}
+
+#endif /* BOTAN_WORKER_POOL_H */
@@ -21,7 +21,11 @@
 #include "botan_view_functions.h"
 
 #include "botan_versioning.h"
+#include "botan_codec.h"
 #include "botan_utility.h"
+#include "botan_secure_buffer.h"
+#include "botan_worker_pool.h"
+#include "botan_derive_cache.h"
 #include "botan_rng.h"
 #include "botan_xof.h"
 #include "botan_block_cipher.h"
@@ -31,6 +35,8 @@
 #include "botan_bcrypt.h"
 #include "botan_pbkdf.h"
 #include "botan_scrypt.h"
+#include "botan_argon2.h"
+#include "botan_password.h"
 #include "botan_kdf.h"
 #include "botan_mpi.h"
 #include "botan_oid.h"
@@ -46,6 +52,8 @@
 #include "botan_pk_key_agreement.h"
 #include "botan_pk_kem_encrypt.h"
 #include "botan_pk_kem_decrypt.h"
+#include "botan_hybrid_kem.h"
+#include "botan_keystore.h"
 #include "botan_fpe.h"
 #include "botan_hotp.h"
 #include "botan_totp.h"
@@ -60,6 +68,9 @@
 JANET_MODULE_ENTRY(JanetTable *env) {
     submod_versioning(env);
     submod_utility(env);
+    submod_secure_buffer(env);
+    submod_worker_pool(env);
+    submod_derive_cache(env);
     submod_rng(env);
     submod_xof(env);
     submod_block_cipher(env);
@@ -69,6 +80,8 @@ JANET_MODULE_ENTRY(JanetTable *env) {
     submod_bcrypt(env);
     submod_pbkdf(env);
     submod_scrypt(env);
+    submod_argon2(env);
+    submod_password(env);
     submod_kdf(env);
     submod_mpi(env);
     submod_oid(env);
@@ -84,6 +97,8 @@ JANET_MODULE_ENTRY(JanetTable *env) {
     submod_pk_key_agreement(env);
     submod_pk_kem_encrypt(env);
     submod_pk_kem_decrypt(env);
+    submod_hybrid_kem(env);
+    submod_keystore(env);
     submod_fpe(env);
     submod_hotp(env);
     submod_totp(env);